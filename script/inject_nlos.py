@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+# Inject NLOS bursts into the ranges of a bag, to measure how fast the localization node recovers on replay.
+# Ranges to the given anchors get a positive bias during each burst; replay the output bag and read the
+# recovery latency and the relocalizations counter from the metrics dump or /diagnostics.
+#
+# usage: inject_nlos.py input.bag output.bag --topic /uwb_endorange_info --anchors 100 101
+#                       [--start 20] [--duration 3] [--period 30] [--bias 2.0] [--seed 0]
+# UwbRange (distance) and localization/UwbRangeEpoch (distances) messages are both handled.
+
+import argparse
+import random
+import rosbag
+
+
+def in_burst(t, args):
+    if t < args.start:
+        return False
+    if args.period <= 0:
+        return t < args.start + args.duration
+    return (t - args.start) % args.period < args.duration
+
+
+def inject(args):
+    random.seed(args.seed)
+    anchors = set(args.anchors)
+    biased = 0
+    with rosbag.Bag(args.output, 'w') as output:
+        begin = None
+        for topic, msg, t in rosbag.Bag(args.input).read_messages():
+            if begin is None:
+                begin = t.to_sec()
+            if topic == args.topic and in_burst(t.to_sec() - begin, args):
+                # NLOS only lengthens the path, the excess varies with the reflection
+                if hasattr(msg, 'distances'):
+                    distances = list(msg.distances)
+                    for i, responder in enumerate(msg.responder_ids):
+                        if responder in anchors or msg.requester_id in anchors:
+                            distances[i] += args.bias * random.uniform(0.5, 1.5)
+                            biased += 1
+                    msg.distances = distances
+                elif msg.responder_id in anchors or msg.requester_id in anchors:
+                    msg.distance += args.bias * random.uniform(0.5, 1.5)
+                    biased += 1
+            output.write(topic, msg, t)
+    return biased
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Inject NLOS bursts into the ranges of a bag.')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    parser.add_argument('--topic', required=True, help='range or range epoch topic')
+    parser.add_argument('--anchors', type=int, nargs='+', required=True, help='anchor IDs blocked during the bursts')
+    parser.add_argument('--start', type=float, default=20.0, help='s after the bag start of the first burst')
+    parser.add_argument('--duration', type=float, default=3.0, help='s, length of a burst')
+    parser.add_argument('--period', type=float, default=0.0, help='s between burst starts, 0 for a single burst')
+    parser.add_argument('--bias', type=float, default=2.0, help='m, mean excess path length')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    print('%d ranges biased, written to %s' % (inject(args), args.output))
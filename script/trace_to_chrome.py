@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+# Convert a binary event trace dumped by the localization node (SIGUSR1 or the
+# trace/dump service) into Chrome trace JSON, viewable in chrome://tracing.
+#
+# usage: trace_to_chrome.py localization.trace [output.json]
+
+import sys
+import json
+import struct
+
+TYPES = ['arrival', 'enqueue', 'solve_begin', 'solve_end', 'publish', 'reject']
+SENSORS = ['general', 'pose', 'range', 'twist', 'imu']
+EVENT = struct.Struct('<QIId')
+
+
+def read(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'UWBTRACE':
+        raise ValueError('%s is not a localization trace' % filename)
+    version, count = struct.unpack_from('<II', data, 8)
+    if version != 1:
+        raise ValueError('unsupported trace version %d' % version)
+    return [EVENT.unpack_from(data, 16 + i * EVENT.size) for i in range(count)]
+
+
+def convert(events):
+    trace = []
+    if not events:
+        return trace
+    origin = events[0][0]
+    for time, kind, id, value in events:
+        ts = (time - origin) / 1000.0  # us
+        name = TYPES[kind] if kind < len(TYPES) else str(kind)
+        event = {'ts': ts, 'pid': 0, 'tid': 0}
+        if name == 'solve_begin':
+            event.update(name='solve', ph='B', args={'pending_chi2': value})
+        elif name == 'solve_end':
+            event.update(name='solve', ph='E', args={'full_window': bool(id), 'chi2': value})
+        elif name == 'arrival':
+            sensor = SENSORS[id] if id < len(SENSORS) else str(id)
+            event.update(name='arrival ' + sensor, ph='i', s='t', tid=1, args={'stamp': value})
+        elif name == 'enqueue':
+            event.update(name='enqueue', ph='i', s='t', tid=1, args={'dimension': id, 'chi2': value})
+        elif name == 'reject':
+            event.update(name='reject', ph='i', s='t', tid=1, args={'id': id, 'distance': value})
+        else:
+            event.update(name=name, ph='i', s='t')
+        trace.append(event)
+    return trace
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: %s localization.trace [output.json]' % sys.argv[0])
+        sys.exit(1)
+    output = sys.argv[2] if len(sys.argv) > 2 else sys.argv[1] + '.json'
+    trace = convert(read(sys.argv[1]))
+    with open(output, 'w') as f:
+        json.dump({'traceEvents': trace, 'displayTimeUnit': 'ms'}, f)
+    print('%d events written to %s' % (len(trace), output))
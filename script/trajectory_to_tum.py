@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+# Convert a binary trajectory log of the localization node (log/binary: true)
+# into the TUM text format read by associate.py and evaluate_ate.py.
+#
+# usage: trajectory_to_tum.py trajectory.bin [trajectory.txt]
+
+import sys
+import struct
+
+RECORD = struct.Struct('<d7f')
+
+
+def convert(source, target):
+    with open(source, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'UWBTRAJ1':
+        raise ValueError('%s is not a binary trajectory log' % source)
+    length, = struct.unpack_from('<I', data, 8)
+    comment = data[12:12 + length].decode()
+    offset = 12 + length
+    count = (len(data) - offset) // RECORD.size
+    with open(target, 'w') as f:
+        for line in comment.splitlines():
+            f.write('# %s\n' % line)
+        for i in range(count):
+            record = RECORD.unpack_from(data, offset + i * RECORD.size)
+            f.write('%.9f %s\n' % (record[0], ' '.join('%g' % v for v in record[1:])))
+    return count
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: %s trajectory.bin [trajectory.txt]' % sys.argv[0])
+        sys.exit(1)
+    target = sys.argv[2] if len(sys.argv) > 2 else sys.argv[1].rsplit('.bin', 1)[0] + '.txt'
+    print('%d poses written to %s' % (convert(sys.argv[1], target), target))
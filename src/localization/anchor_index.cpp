@@ -0,0 +1,104 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "anchor_index.h"
+#include <algorithm>
+
+
+void AnchorIndex::build(const std::vector<uint32_t>& ids, const std::vector<Eigen::Vector3d>& positions)
+{
+    nodes.resize(ids.size());
+
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        nodes[i].position = positions[i];
+        nodes[i].id = ids[i];
+    }
+
+    build(0, nodes.size());
+}
+
+
+void AnchorIndex::build(size_t lo, size_t hi)
+{
+    if (hi <= lo)
+        return;
+
+    Eigen::Vector3d lower = nodes[lo].position, upper = nodes[lo].position;
+
+    for (size_t i = lo + 1; i < hi; ++i)
+    {
+        lower = lower.cwiseMin(nodes[i].position);
+        upper = upper.cwiseMax(nodes[i].position);
+    }
+
+    int axis;
+
+    (upper - lower).maxCoeff(&axis);
+
+    size_t mid = (lo + hi) / 2;
+
+    std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+        [axis](const Node& a, const Node& b){return a.position[axis] < b.position[axis];});
+
+    nodes[mid].axis = axis;
+
+    build(lo, mid);
+
+    build(mid + 1, hi);
+}
+
+
+void AnchorIndex::radius(const Eigen::Vector3d& center, double radius, std::vector<uint32_t>& ids) const
+{
+    ids.clear();
+
+    this->radius(0, nodes.size(), center, radius * radius, ids);
+}
+
+
+void AnchorIndex::radius(size_t lo, size_t hi, const Eigen::Vector3d& center, double radius2, std::vector<uint32_t>& ids) const
+{
+    if (hi <= lo)
+        return;
+
+    size_t mid = (lo + hi) / 2;
+
+    const Node& node = nodes[mid];
+
+    if ((node.position - center).squaredNorm() <= radius2)
+        ids.push_back(node.id);
+
+    double diff = center[node.axis] - node.position[node.axis];
+
+    if (diff <= 0 || diff * diff <= radius2)
+        radius(lo, mid, center, radius2, ids);
+
+    if (diff >= 0 || diff * diff <= radius2)
+        radius(mid + 1, hi, center, radius2, ids);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef ANCHOR_INDEX_H
+#define ANCHOR_INDEX_H
+
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+
+// Static k-d tree over anchor positions, for radius queries in large sites.
+// The tree is implicit in one array: each range [lo, hi) is split at its middle element on the axis of largest spread.
+class AnchorIndex
+{
+public:
+
+    void build(const std::vector<uint32_t>& ids, const std::vector<Eigen::Vector3d>& positions);
+
+    bool empty() const {return nodes.empty();};
+
+    size_t size() const {return nodes.size();};
+
+    void radius(const Eigen::Vector3d& center, double radius, std::vector<uint32_t>& ids) const; // anchors within radius, unordered
+
+private:
+
+    struct Node
+    {
+        Eigen::Vector3d position;
+        uint32_t id;
+        int axis;
+    };
+
+    void build(size_t lo, size_t hi);
+
+    void radius(size_t lo, size_t hi, const Eigen::Vector3d& center, double radius2, std::vector<uint32_t>& ids) const;
+
+    std::vector<Node> nodes;
+};
+
+#endif
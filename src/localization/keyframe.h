@@ -0,0 +1,59 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef KEYFRAME_H
+#define KEYFRAME_H
+
+#include <math.h>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+// Decides when a pose or twist stream opens a new vertex.
+// A threshold of zero disables that criterion; with all of them disabled every message is a keyframe.
+class Keyframe
+{
+public:
+
+    Keyframe(double translation = 0, double rotation = 0, double interval = 0)
+        :translation(translation), rotation(rotation), interval(interval){};
+
+    bool enabled(){return translation > 0 || rotation > 0 || interval > 0;};
+
+    bool check(const Eigen::Isometry3d&, double);
+    // motion and elapsed time since the current keyframe
+
+private:
+
+    double translation; // meter
+
+    double rotation; // radian
+
+    double interval; // second
+};
+
+#endif
@@ -29,7 +29,7 @@
 #include "localization.h"
 
 
-Localization::Localization(ros::NodeHandle n)
+Localization::Localization(ros::NodeHandle n, bool process_signals):threaded(n.param("concurrency/threads", 0) > 0)
 {
     pose_realtime_pub = n.advertise<geometry_msgs::PoseStamped>("realtime/pose", 1);
 
@@ -37,8 +37,14 @@ Localization::Localization(ros::NodeHandle n)
 
     path_optimized_pub = n.advertise<nav_msgs::Path>("optimized/path", 1);
 
+    telemetry_pub = n.advertise<localization::SolverTelemetry>("optimized/telemetry", 10);
+
+    pose_covariance_pub = n.advertise<geometry_msgs::PoseWithCovarianceStamped>("realtime/pose_covariance", 1);
+
     number_measurements = 0;
 
+    outlier_margin = 0;
+
 
 // For g2o optimizer
     solver = new Solver();
@@ -68,16 +74,77 @@ Localization::Localization(ros::NodeHandle n)
     if(n.param("optimizer/minimum_optimize_error", minimum_optimize_error, 1000.0))
         ROS_WARN("Will skip estimation if optimization error is larger than: %f", minimum_optimize_error);
 
+    if(n.param("optimizer/tail_length", tail_length, 0))
+        ROS_WARN("Using tail refinement over the newest %d vertices", tail_length);
+
+    if(n.param("optimizer/tail_iteration", tail_iteration, iteration_max))
+        ROS_WARN("Using tail refinement maximum iteration: %d", tail_iteration);
+
+    if(n.param("optimizer/full_window_rate", full_window_rate, 1.0))
+        ROS_WARN("Using full window optimization rate: %fHz", full_window_rate);
+
+// For solve scheduling
+    pending_impact = 0;
+
+    if(n.param("schedule/skip_chi2", schedule_skip_chi2, 0.0))
+        ROS_WARN("Will skip optimization if the new measurements chi2 is below: %f", schedule_skip_chi2);
+
+    if(n.param("schedule/full_chi2", schedule_full_chi2, 0.0))
+        ROS_WARN("Will optimize the full window if the new measurements chi2 is above: %f", schedule_full_chi2);
+
+    if(n.param("schedule/maximum_rate", maximum_solve_rate, 0.0))
+        ROS_WARN("Using maximum optimization rate: %fHz", maximum_solve_rate);
+
 // For robots
     if(n.getParam("robot/trajectory_length", trajectory_length))
         ROS_WARN("Using robot trajectory_length: %d", trajectory_length);
 
+    if(n.param("robot/window_horizon", window_horizon, 0.0))
+        ROS_WARN("Using robot window horizon: %fs", window_horizon);
+
+    if(n.param("robot/fixed_lag", fixed_lag, window_horizon/2))
+        ROS_WARN("Using optimized pose fixed lag: %fs", fixed_lag);
+
     if(n.param("robot/maximum_velocity", robot_max_velocity, 1.0))
         ROS_WARN("Using robot maximum_velocity: %fm/s", robot_max_velocity);
 
     if(n.param("robot/distance_outlier", distance_outlier, 1.0))
         ROS_WARN("Using uwb outlier rejection distance: %fm", distance_outlier);
 
+// For knot trajectory, ranges are interpolated between knots at a fixed rate
+    if(n.param("robot/knot_interval", knot_interval, 0.0))
+        ROS_WARN("Using knot interval: %fs", knot_interval);
+
+// For keyframe decimation of pose and twist streams
+    double keyframe_translation, keyframe_rotation, keyframe_interval;
+
+    n.param("keyframe/translation", keyframe_translation, 0.0);
+
+    n.param("keyframe/rotation", keyframe_rotation, 0.0);
+
+    n.param("keyframe/interval", keyframe_interval, 0.0);
+
+    keyframe = Keyframe(keyframe_translation, keyframe_rotation, keyframe_interval);
+
+    if (keyframe.enabled())
+        ROS_WARN("Using keyframe translation: %fm rotation: %frad interval: %fs", keyframe_translation, keyframe_rotation, keyframe_interval);
+
+    pose_edge = NULL;
+
+    pose_index = Robot::none;
+
+    key_index = Robot::none;
+
+// For twist preintegration
+    if(n.param("twist/preintegration", flag_twist_preintegration, false))
+        ROS_WARN("Using twist preintegration between range vertices: %s", flag_twist_preintegration ? "true":"false");
+
+// For IMU preintegration
+    imu_key_index = Robot::none;
+
+    if(n.param("imu/gyroscope_noise", gyroscope_noise, 0.01))
+        ROS_WARN("Using imu gyroscope noise: %frad/s", gyroscope_noise);
+
 
 // For UWB initial position parameters reading
     if(!n.getParam("/uwb/nodesId", nodesId))
@@ -89,11 +156,13 @@ Localization::Localization(ros::NodeHandle n)
     self_id = nodesId.back();
     ROS_WARN("Init self robot ID: %d with moving option", self_id);
 
+    robots.reserve(nodesId.size());
+
     for (size_t i = 0; i < nodesId.size(); ++i)
     {
-        if(n.hasParam("topic/relative_range")||self_id==nodesId[i])
+        if(n.hasParam("topic/relative_range")||self_id==(uint32_t)nodesId[i])
         {
-            robots.emplace(nodesId[i], Robot(nodesId[i], false, trajectory_length));
+            robots.emplace(nodesId[i], Robot(nodesId[i], false, trajectory_length, window_horizon));
             ROS_WARN("robot ID %d is set moving", nodesId[i]);
         }
         else // for fixed anchor
@@ -103,10 +172,146 @@ Localization::Localization(ros::NodeHandle n)
         pose(0,3) = nodesPos[i*3];
         pose(1,3) = nodesPos[i*3+1];
         pose(2,3) = nodesPos[i*3+2];
-        robots.at(nodesId[i]).init(optimizer, pose);
+        robots.at(nodesId[i]).init(optimizer, vertex_ids, pose);
         ROS_WARN("Init robot ID: %d with position (%.2f,%.2f,%.2f)", nodesId[i], pose(0,3), pose(1,3), pose(2,3));
     }
 
+// For divergence detection and relocalization from a multilateration fix
+    diverged = 0;
+
+    solved = false;
+
+    window_error = 0;
+
+    recovering = false;
+
+    last_good_pose = robots.at(self_id).last_vertex()->estimate();
+
+    if(n.param("recovery/solves", recovery_solves, 0))
+        ROS_WARN("Using recovery after %d diverged solves", recovery_solves);
+
+    if(n.param("recovery/range_age", recovery_range_age, 1.0))
+        ROS_WARN("Using recovery range age: %fs", recovery_range_age);
+
+    if(n.param("recovery/maximum_residual", recovery_residual, 0.3))
+        ROS_WARN("Using recovery maximum residual: %fm", recovery_residual);
+
+// For passive tags, they only listen and are tracked from time differences of arrival
+    if(n.getParam("tdoa/tags", tdoa_tags))
+    {
+        Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+
+        for (size_t i = 0; i + 2 < nodesPos.size(); i += 3)
+            pose.translation() += Eigen::Vector3d(nodesPos[i], nodesPos[i+1], nodesPos[i+2]) / (nodesPos.size()/3);
+
+        for (auto id : tdoa_tags)
+        {
+            if (robots.count(id))
+                continue;
+
+            robots.emplace(id, Robot(id, false, trajectory_length, window_horizon));
+            robots.at(id).init(optimizer, vertex_ids, pose);
+            ROS_WARN("Init passive tag ID: %d with position (%.2f,%.2f,%.2f)", id, pose(0,3), pose(1,3), pose(2,3));
+        }
+    }
+
+// For time ordering of all measurement streams before graph insertion
+    int reorder_capacity;
+
+    if(n.param("reorder/latency", reorder_latency, 0.0))
+        ROS_WARN("Using reorder/latency: %fs", reorder_latency);
+
+    if(n.param("reorder/capacity", reorder_capacity, 1000))
+        ROS_WARN("Using reorder/capacity: %d", reorder_capacity);
+
+    if(n.param("reorder/queue_size", reorder_queue_size, 1000))
+        ROS_WARN("Using reorder/queue_size: %d", reorder_queue_size);
+
+    reorder_buffer = ReorderBuffer(reorder_latency, reorder_capacity);
+
+// For concurrent ingestion and solving, measurements are queued to a worker thread
+    int worker_threads, capacity;
+
+    if(n.param("concurrency/threads", worker_threads, 0))
+        ROS_WARN("Using concurrency/threads: %d", worker_threads);
+
+    if(n.param("concurrency/capacity", capacity, 10000))
+        ROS_WARN("Using concurrency/capacity: %d", capacity);
+
+    task_capacity = capacity;
+
+    dropped_tasks = 0;
+
+    deferred = false;
+
+    running = true;
+
+    if (threaded)
+        worker = std::thread(&Localization::run_worker, this);
+
+// For anchor gating and selection in large sites
+    if(n.param("anchors/radius", anchor_radius, 0.0))
+        ROS_WARN("Using anchors/radius: %fm", anchor_radius);
+
+    if(n.param("anchors/nearest", anchor_nearest, 0))
+        ROS_WARN("Using anchors/nearest: %d", anchor_nearest);
+
+    build_anchor_index();
+
+// For innovation gating of ranges, replaces robot/distance_outlier when enabled
+    double gate_chi2;
+
+    int gate_burst, gate_recovery, gate_lockout;
+
+    if(n.param("gate/chi2", gate_chi2, 0.0))
+        ROS_WARN("Using range gate chi2: %f", gate_chi2);
+
+    if(n.param("gate/burst", gate_burst, 3))
+        ROS_WARN("Using range gate NLOS burst: %d rejections", gate_burst);
+
+    if(n.param("gate/recovery", gate_recovery, 3))
+        ROS_WARN("Using range gate NLOS recovery: %d ranges", gate_recovery);
+
+    if(n.param("gate/lockout", gate_lockout, 20))
+        ROS_WARN("Using range gate lockout: %d rejections", gate_lockout);
+
+    if(n.param("gate/window", gate_window, trajectory_length))
+        ROS_WARN("Using range gate window: %d vertices", gate_window);
+
+    range_gate = RangeGate(gate_chi2, gate_burst, gate_recovery, gate_lockout);
+
+// For the marginal covariance of the newest pose
+    covariance_valid = false;
+
+    if(n.param("covariance/window", covariance_window, trajectory_length))
+        ROS_WARN("Using covariance window: %d vertices", covariance_window);
+
+// For checkpoint and warm restart of the window
+    double checkpoint_period;
+
+    if(n.param<string>("checkpoint/filename", checkpoint_filename, ""))
+        ROS_WARN("Using checkpoint/filename: %s", checkpoint_filename.c_str());
+
+    if(n.param("checkpoint/period", checkpoint_period, 5.0))
+        ROS_WARN("Using checkpoint/period: %fs", checkpoint_period);
+
+    if(n.param("checkpoint/maximum_age", checkpoint_maximum_age, 30.0))
+        ROS_WARN("Using checkpoint/maximum_age: %fs", checkpoint_maximum_age);
+
+    if(n.param("checkpoint/sigma_translation", checkpoint_sigma_translation, 0.5))
+        ROS_WARN("Using checkpoint/sigma_translation: %fm", checkpoint_sigma_translation);
+
+    if(n.param("checkpoint/sigma_rotation", checkpoint_sigma_rotation, 0.2))
+        ROS_WARN("Using checkpoint/sigma_rotation: %frad", checkpoint_sigma_rotation);
+
+    if (!checkpoint_filename.empty())
+    {
+        restore_checkpoint();
+
+        if (checkpoint_period > 0)
+            checkpoint_timer = n.createTimer(ros::Duration(checkpoint_period), &Localization::checkpoint_callback, this);
+    }
+
 // for multi-antena with offsets
     std::vector<double> antennaOffset;
     if(n.getParam("/uwb/antennaOffset", antennaOffset))
@@ -122,7 +327,19 @@ Localization::Localization(ros::NodeHandle n)
         }
     }
 
+    if(n.param<bool>("antenna/multi_range", flag_multi_range, false))
+        ROS_WARN("Using antenna/multi_range: %s", flag_multi_range ? "true":"false");
+
+    if (flag_multi_range && offsets.size() > g2o::EdgeSE3MultiRange::Antennas)
+        ROS_WARN("Multi range edges hold %d antennas, ranges of the others are added as single ranges", g2o::EdgeSE3MultiRange::Antennas);
+
+    if(n.param("antenna/window", antenna_window, 0.05))
+        ROS_WARN("Using antenna/window: %fs", antenna_window);
+
 // For Debug
+    if(n.param<bool>("log/binary", flag_binary_log, false))
+        ROS_WARN("Using log/binary: %s", flag_binary_log ? "true":"false");
+
     if(n.getParam("log/filename_prefix", name_prefix))
         if(antennaOffset.size() > 0)
             set_file(antennaOffset);
@@ -158,560 +375,2391 @@ Localization::Localization(ros::NodeHandle n)
     if(n.param<bool>("publish_flag/relative_range", publish_relative_range, false))
         ROS_WARN("Using publish_flag/relative_range: %s", publish_relative_range ? "true":"false");
 
-}
+    if(n.param<double>("publish_flag/path_rate", path_rate, 0.0))
+        ROS_WARN("Using publish_flag/path_rate: %fHz", path_rate);
 
+    if(n.param<bool>("publish_flag/telemetry", publish_telemetry, false))
+        ROS_WARN("Using publish_flag/telemetry: %s", publish_telemetry ? "true":"false");
 
-void Localization::solve()
-{
-    timer.tic();
+    if(n.param<bool>("publish_flag/covariance", publish_covariance, false))
+        ROS_WARN("Using publish_flag/covariance: %s", publish_covariance ? "true":"false");
 
-    optimizer.initializeOptimization();
+    double metrics_period;
 
-    optimizer.optimize(iteration_max);
+    if(n.param<double>("metrics/period", metrics_period, 1.0))
+        ROS_WARN("Using metrics/period: %fs", metrics_period);
 
-    // auto edges = optimizer.activeEdges();
-    // if(edges.size()>100)
-    // {
-    //     for(auto edge:edges)
-    //         if (edge->chi2() > 2.0 && edge->dimension () ==1)
-    //         {
-    //             edge->setLevel(1);
-    //             ROS_WARN("Removed one Range Edge");
-    //         }
-    // }
-    // ROS_INFO("Graph optimized with error: %f", optimizer.chi2());
+    if(n.param<string>("metrics/filename", metrics_filename, ""))
+        ROS_WARN("Using metrics/filename: %s", metrics_filename.c_str());
 
-    // g2o::SparseBlockMatrix<MatrixXd> spinv;
+    diagnostics_pub = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
 
-    // if(optimizer.computeMarginals(spinv, robots.at(self_id).last_vertex()))
-    //     cout<<spinv.block(0,0)<<endl;    
-    // else
-    //     cout<<"can't compute"<<endl;
+    if (metrics_period > 0)
+        diagnostics_timer = n.createTimer(ros::Duration(metrics_period), &Localization::publish_diagnostics, this);
 
-    timer.toc();
-}
+    metrics_service = n.advertiseService("metrics/dump", &Localization::dump_metrics, this);
 
+    if(n.param<string>("trace/filename", trace_filename, "/tmp/localization.trace"))
+        ROS_WARN("Using trace/filename: %s", trace_filename.c_str());
 
-void Localization::publish()
-{
-    double error = optimizer.chi2();
+    // the handler is process wide, so in a nodelet manager only the service is used
+    bool trace_signal;
 
-    if (error < minimum_optimize_error)
-        ROS_INFO("Graph optimized with error: %f ", error);
-    else
+    if(n.param<bool>("trace/signal", trace_signal, false) && !process_signals)
+        ROS_WARN("Ignoring trace/signal in a shared process, use the trace/dump service");
+
+    if (trace_signal && process_signals)
     {
-        ROS_WARN("Skip optimization with error: %f ", error);
-        return;
-    }
-    
+        ROS_WARN("Dumping the trace on SIGUSR1");
 
-    auto pose = robots.at(self_id).current_pose();
+        Trace::install_signal(SIGUSR1);
 
-    pose.header.frame_id = frame_source;
+        trace_timer = n.createTimer(ros::Duration(0.2), &Localization::poll_trace, this);
+    }
 
-    pose_realtime_pub.publish(pose);
+    trace_service = n.advertiseService("trace/dump", &Localization::dump_trace, this);
+}
 
-    auto path = robots.at(self_id).vertices2path();
 
-    path->header.frame_id = frame_source;
+void Localization::subscribe(ros::NodeHandle& n)
+{
+    string pose_topic, range_topic, range_epoch_topic, tdoa_topic, lidar_topic, imu_topic, twist_topic, relative_topic;
 
-    path_optimized_pub.publish(*path);
+    if(n.getParam("topic/pose", pose_topic))
+    {
+        pose_sub = subscribe_ordered(n, pose_topic, 1000, &Localization::addPoseEdge);
+        ROS_WARN("Subscribing to: %s",pose_topic.c_str());
+    }
 
-    pose_optimized_pub.publish(path->poses[trajectory_length/2]);
+    if(n.getParam("topic/range", range_topic))
+    {
+        range_sub = subscribe_ordered(n, range_topic, 1, &Localization::addRangeEdge);
+        ROS_WARN("Subscribing to: %s", range_topic.c_str());
+    }
 
-    if(flag_save_file)
+    if(n.getParam("topic/range_epoch", range_epoch_topic))
     {
-        save_file(pose, realtime_filename);
-        save_file(path->poses[trajectory_length/2], optimized_filename);        
+        range_epoch_sub = subscribe_ordered(n, range_epoch_topic, 1, &Localization::addRangeEpoch);
+        ROS_WARN("Subscribing to: %s", range_epoch_topic.c_str());
     }
 
-    if(publish_tf)
+    if(n.getParam("topic/tdoa", tdoa_topic))
     {
-        if(publish_relative_range)
-        {
-            for (size_t i = 0; i < nodesId.size(); ++i)
-            {
-                auto pose = robots.at(nodesId[i]).current_pose();
+        tdoa_sub = subscribe_ordered(n, tdoa_topic, 1, &Localization::addTdoaEdge);
+        ROS_WARN("Subscribing to: %s", tdoa_topic.c_str());
+    }
 
-                pose.header.frame_id = frame_source;
+    if(n.getParam("topic/twist", twist_topic))
+    {
+        twist_sub = subscribe_ordered(n, twist_topic, 1, &Localization::addTwistEdge);
+        ROS_WARN("Subscribing to: %s", twist_topic.c_str());
+    }
 
-                tf::poseMsgToTF(pose.pose, transform);
-                
-                br.sendTransform(tf::StampedTransform(transform, pose.header.stamp, frame_source, "rl_" + std::to_string(nodesId[i]))); 
-            }
-        }
-        else
-        {
-            tf::poseMsgToTF(pose.pose, transform);
-            br.sendTransform(tf::StampedTransform(transform, pose.header.stamp, frame_source, frame_target));
-        }
+    if(n.getParam("topic/lidar", lidar_topic))
+    {
+        lidar_sub = subscribe_ordered(n, lidar_topic, 1, &Localization::addLidarEdge);
+        ROS_WARN("Subscribing to: %s", lidar_topic.c_str());
+    }
+
+    if(n.getParam("topic/imu", imu_topic))
+    {
+        imu_sub = subscribe_ordered(n, imu_topic, 1, &Localization::addImuEdge);
+        ROS_WARN("Subscribing to: %s", imu_topic.c_str());
+    }
 
+#ifdef RELATIVE_LOCALIZATION
+    if(n.getParam("topic/relative_range", relative_topic))
+    {
+        relative_sub = subscribe_dispatched(n, relative_topic, 1, &Localization::addRLRangeEdge);
+        ROS_WARN("Subscribing to: %s", relative_topic.c_str());
     }
+#endif
+
+    if (reorder_buffer.enabled())
+        reorder_timer = n.createTimer(ros::Duration(reorder_latency), &Localization::flush_reorder, this);
+
+    if (flag_multi_range && antenna_window > 0)
+        antenna_timer = n.createTimer(ros::Duration(antenna_window), &Localization::flush_antenna_timer, this);
+
+    anchors_service = n.advertiseService("anchors/update", &Localization::update_anchors, this);
 
+    config_server.reset(new dynamic_reconfigure::Server<localization::localizationConfig>(n));
+
+    config_server->setCallback(boost::bind(&Localization::configCallback, this, _1, _2));
 }
 
 
-void Localization::addPoseEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& pose_cov_)
+void Localization::solve()
 {
-    geometry_msgs::PoseWithCovarianceStamped pose_cov(*pose_cov_);
+    if (deferrable())
+    {
+        metrics.count(Metrics::skipped_solves);
+        return;
+    }
+
+    ros::WallTime now = ros::WallTime::now();
+
+    // skip when the new measurements agree with the current estimate, or when solving too often
+    if (pending_impact < schedule_skip_chi2 || (maximum_solve_rate > 0 && (now - solve_time).toSec() < 1.0/maximum_solve_rate))
+    {
+        metrics.count(Metrics::skipped_solves);
+        return;
+    }
 
-    if (pose_cov.header.frame_id != robots.at(self_id).last_header(sensor_type.pose).frame_id)
-        key_vertex = robots.at(self_id).last_vertex(sensor_type.pose);
+    trace.record(Trace::solve_begin, 0, pending_impact);
 
-    auto new_vertex = robots.at(self_id).new_vertex(sensor_type.pose, pose_cov.header, optimizer);
+    bool full = tail_length == 0 || full_window_rate <= 0 || (now - full_window_time).toSec() >= 1.0/full_window_rate
+        || (schedule_full_chi2 > 0 && pending_impact >= schedule_full_chi2);
 
-    g2o::EdgeSE3 *edge = new g2o::EdgeSE3();
+    if (full)
+    {
+        auto start = Metrics::now();
 
-    edge->vertices()[0] = key_vertex;
+        optimizer.initializeOptimization();
 
-    edge->vertices()[1] = new_vertex;
+        metrics.record(Metrics::initialize, start);
 
-    Eigen::Isometry3d measurement;
+        optimize(iteration_max, true, start);
 
-    tf::poseMsgToEigen(pose_cov.pose.pose, measurement);
+        full_window_time = now;
 
-    edge->setMeasurement(measurement);
+        outlier_margin = 0;
 
-    Eigen::Map<Eigen::MatrixXd> covariance(pose_cov.pose.covariance.data(), 6, 6);
+        // a tail solve's chi2 covers only the tail's edges, the window is judged on full solves
+        window_error = optimizer.chi2();
 
-    edge->setInformation(covariance.inverse());
+        solved = true;
+    }
+    else
+        solve_tail();
 
-    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+    for (auto& robot : robots)
+        robot.second.mark_changed(full ? robot.second.size() : tail_length);
 
-    optimizer.addEdge(edge);
+    pending_impact = 0;
 
-    ROS_INFO("added pose edge id: %d frame_id: %s;", pose_cov.header.seq, pose_cov.header.frame_id.c_str());
+    solve_time = now;
 
-    if (publish_pose)
-    {
-        solve();
-        publish();
-    }
+    trace.record(Trace::solve_end, full, optimizer.chi2());
+
+    if (publish_covariance || range_gate.enabled())
+        update_covariance();
+
+    // auto edges = optimizer.activeEdges();
+    // if(edges.size()>100)
+    // {
+    //     for(auto edge:edges)
+    //         if (edge->chi2() > 2.0 && edge->dimension () ==1)
+    //         {
+    //             edge->setLevel(1);
+    //             ROS_WARN("Removed one Range Edge");
+    //         }
+    // }
+    // ROS_INFO("Graph optimized with error: %f", optimizer.chi2());
 }
 
 
+void Localization::detect_divergence()
+{
+    // only a full solve confirms the divergence, without one the error is still the one already counted
+    bool counted = solved;
 
+    solved = false;
 
+    if (!counted || robots.at(self_id).is_static())
+        return;
 
-#ifdef TIME_DOMAIN
-void Localization::addRangeEdge(const uwb_driver::UwbRange::ConstPtr& uwb)
-#else
-void Localization::addRangeEdge(const bitcraze_lps_estimator::UwbRange::ConstPtr& uwb)
-#endif
+    if (diverged++ == 0 && !recovering)
+        divergence_stamp = robots.at(self_id).last_header().stamp;
+
+    // a diverged window doesn't recover by itself, it only keeps paying for full solves
+    if (recovery_solves > 0 && diverged >= recovery_solves && relocalize(robots.at(self_id).last_header().stamp))
+    {
+        diverged = 0;
+
+        recovering = true;
+
+        metrics.count(Metrics::relocalizations);
+    }
+}
+
+
+bool Localization::relocalize(ros::Time stamp)
 {
+    auto& robot = robots.at(self_id);
 
-    ++number_measurements;
+    multilateration.clear();
+
+    for (auto& range : recent_ranges)
+        if (robots.count(range.first) && (stamp - range.second.stamp).toSec() <= recovery_range_age)
+            multilateration.add(robots.at(range.first).last_vertex()->estimate().translation(), range.second.distance, range.second.distance_err);
 
+    // from the last published pose, the fix then stays on its side of coplanar anchors
+    Eigen::Vector3d position = last_good_pose.translation();
 
-    double distance_estimation= (robots.at(uwb->requester_id).last_vertex()->estimate().translation() -
-                                 robots.at(uwb->responder_id).last_vertex()->estimate().translation()).norm();
+    double residual;
 
-    if (number_measurements > trajectory_length && abs(distance_estimation-uwb->distance) > distance_outlier)
+    if (!multilateration.solve(position, residual) || residual > recovery_residual)
     {
-        ROS_WARN("Reject ID: %d measurement: %fm", uwb->responder_id, uwb->distance);
-        return;
+        ROS_WARN("Relocalization failed with %zu ranges", multilateration.size());
+        return false;
     }
 
+    Eigen::Isometry3d pose = last_good_pose;
 
-    double dt_requester = uwb->header.stamp.toSec() - robots.at(uwb->requester_id).last_header().stamp.toSec();
-    double dt_responder = uwb->header.stamp.toSec() - robots.at(uwb->responder_id).last_header().stamp.toSec();
-    double distance_cov = pow(uwb->distance_err, 2);
-    double cov_requester = pow(robot_max_velocity*dt_requester/3, 2); //3 sigma priciple
+    pose.translation() = position;
 
-    auto vertex_last_requester = robots.at(uwb->requester_id).last_vertex();
-    auto vertex_last_responder = robots.at(uwb->responder_id).last_vertex();
-    auto vertex_responder = robots.at(uwb->responder_id).new_vertex(sensor_type.range, uwb->header, optimizer);
-     
-    auto frame_id = robots.at(uwb->requester_id).last_header().frame_id;
+    std_msgs::Header header = robot.last_header();
 
-    if( (frame_id.find(uwb->header.frame_id)!=string::npos) || (frame_id.find("none")!=string::npos))
-    {    
-        auto vertex_requester = robots.at(uwb->requester_id).new_vertex(sensor_type.range, uwb->header, optimizer);
+    header.stamp = stamp;
 
-        auto edge = create_range_edge(vertex_requester, vertex_responder, uwb->distance, distance_cov);
+    robot.reset(optimizer, pose, header);
 
-        if(uwb->antenna > 0)
-            edge->setVertexOffset(0, offsets[uwb->antenna-1]);
-        
-        optimizer.addEdge(edge);
+    // the window is gone, so are the vertices held for folding and preintegration
+    pose_edge = NULL;
 
-        auto edge_requester_range = create_range_edge(vertex_last_requester, vertex_requester, 0, cov_requester);
+    pose_index = Robot::none;
 
-        optimizer.addEdge(edge_requester_range); 
+    key_index = Robot::none;
 
-        if(uwb->antenna > 0)
-            ROS_INFO("added two requester range edge on id: <%d> with offsets %d <%.2f, %.2f, %.2f> at %.3f;",
-                uwb->responder_id, uwb->antenna-1, offsets[uwb->antenna-1](0,3), offsets[uwb->antenna-1](1,3), offsets[uwb->antenna-1](2,3), dt_requester);
-        else
-            ROS_INFO("added two requester range edge on id: <%d> ", uwb->responder_id);
-    }
-    else
-    {
-        auto edge = create_range_edge(vertex_last_requester, vertex_responder, uwb->distance, distance_cov + cov_requester);
+    imu_key_index = Robot::none;
 
-        optimizer.addEdge(edge); // decrease computation
+    range_gate.clear(self_id);
 
-        ROS_INFO("added requester edge with id: <%d>", uwb->responder_id);
+    covariance_valid = false;
 
+    pending_impact = 0;
 
-    }
+    window_error = 0;
 
+    add_prior(robot.last_vertex(), std::max(residual, 0.1), M_PI);
 
-    if (!robots.at(uwb->responder_id).is_static())
-    {
-        double cov_responder = pow(robot_max_velocity*dt_responder/3, 2); //3 sigma priciple
+    // drop the removed edges from the active set before anything reads the error again
+    optimizer.initializeOptimization();
 
-        auto edge_responder_range = create_range_edge(vertex_last_responder, vertex_responder, 0, cov_responder);
+    // keep the gate, only widened by the fix uncertainty until the next full solve, so the NLOS ranges stay out
+    outlier_margin = 3 * std::max(residual, 0.1);
 
-        optimizer.addEdge(edge_responder_range);
+    ROS_WARN("Relocalized robot ID: %d at (%.2f,%.2f,%.2f) from %zu ranges with residual %.3fm",
+        self_id, position(0), position(1), position(2), multilateration.size(), residual);
 
-        ROS_INFO("added responder trajectory edge;");
-    }
-        
-    if (publish_range && number_measurements > trajectory_length)
-    {
-        solve();
-        publish();
-    }
+    return true;
 }
 
-#ifdef RELATIVE_LOCALIZATION
-void Localization::addRLRangeEdge(const uwb_reloc::uwbTalkData::ConstPtr& uwb)
+
+void Localization::update_covariance()
 {
-    std_msgs::Header RLheader;
-    RLheader.stamp  = uwb->time_stamp;
-    RLheader.frame_id = "uwb";
+    auto& robot = robots.at(self_id);
 
-    double dt_requester = uwb->time_stamp.toSec() - robots.at(uwb->rqstrId).last_header().stamp.toSec();
-    double dt_responder = uwb->time_stamp.toSec() - robots.at(uwb->rspdrId).last_header().stamp.toSec();
+    if (robot.is_static())
+        return;
 
-    double distance_cov = pow(0.054, 2);
-    double cov_requester = pow(robot_max_velocity*dt_requester/3, 2); //3 sigma priciple
-    double cov_responder = pow(robot_max_velocity*dt_responder/3, 2); //3 sigma priciple
+    auto start = Metrics::now();
 
-    auto vertex_last_requester = robots.at(uwb->rqstrId).last_vertex();
-    auto vertex_last_responder = robots.at(uwb->rspdrId).last_vertex();
+    std::vector<g2o::VertexSE3*> trajectory;
 
-    auto vertex_requester = robots.at(uwb->rqstrId).new_vertex(sensor_type.range, RLheader, optimizer);
-    auto vertex_responder = robots.at(uwb->rspdrId).new_vertex(sensor_type.range, RLheader, optimizer);
+    robot.tail(covariance_window, trajectory);
 
-    auto edge = create_range_edge(vertex_requester, vertex_responder, uwb->d, distance_cov);   
-    optimizer.addEdge(edge);
+    // the full sparse inverse costs more than the solve, the trajectory alone is a few 6x6 eliminations
+    covariance_valid = marginal.compute(trajectory, pose_covariance);
 
-    if (!robots.at(uwb->rspdrId).is_static())
-    {
-        auto edge_responder_range = create_range_edge(vertex_last_responder, vertex_responder, 0, cov_responder);
-        optimizer.addEdge(edge_responder_range);
-        ROS_INFO("added responder trajectory edge;");
-    }
+    covariance_stamp = robot.last_header().stamp;
 
-    // add EdgeSE3 using velocity information
-    if (!robots.at(uwb->rqstrId).is_static())
-    {
-        g2o::EdgeSE3 *edge_requester = new g2o::EdgeSE3();
-        edge_requester->vertices()[0] = vertex_last_requester;
-        edge_requester->vertices()[1] = vertex_requester;
+    metrics.record(Metrics::marginal, start);
+}
 
-        Eigen::Isometry3d measurement;
+
+void Localization::solve_tail()
+{
+    g2o::HyperGraph::VertexSet tail;
+
+    for (auto& robot : robots)
+        if (!robot.second.is_static())
+            robot.second.tail(tail_length, tail);
+
+    // older neighbours of the tail are held fixed for this solve
+    g2o::HyperGraph::VertexSet vertices(tail);
+
+    std::vector<g2o::OptimizableGraph::Vertex*> boundary;
+
+    for (auto vertex : tail)
+        for (auto edge : vertex->edges())
+            for (auto neighbour : edge->vertices())
+                if (tail.count(neighbour) == 0)
+                {
+                    auto v = static_cast<g2o::OptimizableGraph::Vertex*>(neighbour);
+
+                    vertices.insert(v);
+
+                    if (!v->fixed())
+                    {
+                        v->setFixed(true);
+                        boundary.push_back(v);
+                    }
+                }
+
+    auto start = Metrics::now();
+
+    optimizer.initializeOptimization(vertices);
+
+    metrics.record(Metrics::initialize, start);
+
+    optimize(tail_iteration, false, start);
+
+    for (auto vertex : boundary)
+        vertex->setFixed(false);
+}
+
+
+void Localization::optimize(int iterations, bool full, Metrics::Clock::time_point start)
+{
+    if (publish_telemetry)
+    {
+        optimizer.computeActiveErrors();
+
+        edge_chi2(telemetry.range_chi2_initial, telemetry.motion_chi2_initial, telemetry.se3_chi2_initial, telemetry.prior_chi2_initial);
+    }
+
+    auto optimize_start = Metrics::now();
+
+    int used = optimizer.optimize(iterations);
+
+    metrics.record(Metrics::optimize, optimize_start);
+
+    // the cached edge errors are those of the last step tried, which may have been rejected
+    optimizer.computeActiveErrors();
+
+    if (!publish_telemetry)
+        return;
+
+    telemetry.duration = std::chrono::duration<double>(Metrics::now() - start).count();
+
+    edge_chi2(telemetry.range_chi2_final, telemetry.motion_chi2_final, telemetry.se3_chi2_final, telemetry.prior_chi2_final);
+
+    telemetry.saturated_edges = 0;
+
+    for (auto edge : optimizer.activeEdges())
+        if (edge->robustKernel() != NULL && edge->chi2() > pow(edge->robustKernel()->delta(), 2))
+            ++telemetry.saturated_edges;
+
+    telemetry.header = robots.at(self_id).last_header();
+
+    telemetry.full_window = full;
+
+    telemetry.vertices = optimizer.activeVertices().size();
+
+    telemetry.edges = optimizer.activeEdges().size();
+
+    telemetry.window_span = robots.at(self_id).span();
+
+    telemetry.iterations = used;
+
+    telemetry.iteration_max = iterations;
+
+    telemetry.lambda = optimizationsolver->currentLambda();
+
+    telemetry_pub.publish(telemetry);
+}
+
+
+void Localization::publish()
+{
+    if (deferrable())
+    {
+        metrics.count(Metrics::skipped_publishes);
+        return;
+    }
+
+    auto start = Metrics::now();
+
+    double error = window_error;
+
+    if (error < minimum_optimize_error)
+        MEASUREMENT_INFO("Graph optimized with error: %f ", error);
+    else
+    {
+        ROS_WARN("Skip optimization with error: %f ", error);
+        metrics.count(Metrics::skipped_publishes);
+        detect_divergence();
+        return;
+    }
+
+    if (recovering)
+    {
+        double recovery = (robots.at(self_id).last_header().stamp - divergence_stamp).toSec();
+
+        metrics.record(Metrics::recovery, recovery);
+
+        ROS_WARN("Recovered from divergence in %.3fs", recovery);
+
+        recovering = false;
+    }
+
+    diverged = 0;
+
+    solved = false;
+
+    last_good_pose = robots.at(self_id).last_vertex()->estimate();
+    
+
+    auto pose = robots.at(self_id).current_pose();
+
+    pose.header.frame_id = frame_source;
+
+    pose_realtime_pub.publish(pose);
+
+    if (publish_covariance && covariance_valid)
+    {
+        geometry_msgs::PoseWithCovarianceStamped pose_cov;
+
+        pose_cov.header = pose.header;
+
+        pose_cov.pose.pose = pose.pose;
+
+        Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor> > covariance(pose_cov.pose.covariance.data());
+
+        covariance = pose_covariance;
+
+        // a skipped solve leaves the marginal behind the published pose, grow it by the motion model since
+        double dt = (pose.header.stamp - covariance_stamp).toSec();
+
+        if (dt > 0)
+            covariance.topLeftCorner<3,3>() += Eigen::Matrix3d::Identity() * pow(robot_max_velocity*dt/3, 2);
+
+        pose_covariance_pub.publish(pose_cov);
+    }
+
+    auto path_start = Metrics::now();
+
+    auto path = robots.at(self_id).vertices2path();
+
+    metrics.record(Metrics::path, path_start);
+
+    path->header.frame_id = frame_source;
+
+    // the whole window is serialized, so publish it only to subscribers and at most at path_rate
+    if (path_optimized_pub.getNumSubscribers() > 0 && (path_rate <= 0 || (ros::WallTime::now() - path_time).toSec() >= 1.0/path_rate))
+    {
+        path_optimized_pub.publish(*path);
+
+        path_time = ros::WallTime::now();
+    }
+
+    auto lag = fixed_lag_index(path);
+
+    pose_optimized_pub.publish(path->poses[lag]);
+
+    if(flag_save_file)
+    {
+        realtime_logger.log(pose);
+        optimized_logger.log(path->poses[lag]);
+    }
+
+    if(publish_tf)
+    {
+        if(publish_relative_range)
+        {
+            for (size_t i = 0; i < nodesId.size(); ++i)
+            {
+                auto pose = robots.at(nodesId[i]).current_pose();
+
+                pose.header.frame_id = frame_source;
+
+                tf::poseMsgToTF(pose.pose, transform);
+                
+                br.sendTransform(tf::StampedTransform(transform, pose.header.stamp, frame_source, "rl_" + std::to_string(nodesId[i]))); 
+            }
+        }
+        else
+        {
+            tf::poseMsgToTF(pose.pose, transform);
+            br.sendTransform(tf::StampedTransform(transform, pose.header.stamp, frame_source, frame_target));
+        }
+
+        for (auto id : tdoa_tags)
+        {
+            auto pose = robots.at(id).current_pose();
+
+            tf::poseMsgToTF(pose.pose, transform);
+
+            br.sendTransform(tf::StampedTransform(transform, pose.header.stamp, frame_source, "tag_" + std::to_string(id)));
+        }
+
+    }
+
+    metrics.record(Metrics::publish, start);
+
+    trace.record(Trace::publish);
+}
+
+
+void Localization::addPoseEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& pose_cov_)
+{
+    auto start = ingest(sensor_type.pose, pose_cov_->header.stamp);
+
+    const geometry_msgs::PoseWithCovarianceStamped& pose_cov = *pose_cov_;
+
+    auto& robot = robots.at(self_id);
+
+    // also a new key when the key vertex left the window or went with a relocalization
+    bool new_key = pose_cov.header.frame_id != robot.last_header(sensor_type.pose).frame_id
+        || robot.vertex_at(key_index) == NULL;
+
+    if (new_key)
+        key_index = robot.last_index(sensor_type.pose);
+
+    Eigen::Isometry3d measurement;
+
+    tf::poseMsgToEigen(pose_cov.pose.pose, measurement);
+
+    Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor> > covariance(pose_cov.pose.covariance.data());
+
+    // fold into the current edge while its vertex is still the newest one and no keyframe is due
+    bool fold = !new_key && pose_edge != NULL
+        && pose_index == robot.last_index()
+        && robots.at(self_id).last_header().stamp == pose_stamp
+        && !keyframe.check(pose_keyframe.inverse() * measurement, pose_cov.header.stamp.toSec() - pose_keyframe_stamp.toSec());
+
+    if (fold)
+    {
+        pose_edge->setMeasurement(measurement);
+
+        pose_edge->setInformation(covariance.inverse());
+
+        robots.at(self_id).update_last_header(sensor_type.pose, pose_cov.header);
+
+        pose_stamp = pose_cov.header.stamp;
+
+        MEASUREMENT_INFO("folded pose edge id: %d frame_id: %s;", pose_cov.header.seq, pose_cov.header.frame_id.c_str());
+    }
+    else
+    {
+        auto new_vertex = robots.at(self_id).new_vertex(sensor_type.pose, pose_cov.header, optimizer);
+
+        g2o::EdgeSE3 *edge = new g2o::EdgeSE3();
+
+        edge->vertices()[0] = robot.vertex_at(key_index);
+
+        edge->vertices()[1] = new_vertex;
+
+        edge->setMeasurement(measurement);
+
+        edge->setInformation(covariance.inverse());
+
+        edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+        add_edge(edge);
+
+        pose_edge = edge;
+
+        pose_index = robot.last_index();
+
+        pose_keyframe = measurement;
+
+        pose_keyframe_stamp = pose_stamp = pose_cov.header.stamp;
+
+        MEASUREMENT_INFO("added pose edge id: %d frame_id: %s;", pose_cov.header.seq, pose_cov.header.frame_id.c_str());
+    }
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_pose)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+
+
+
+#ifdef TIME_DOMAIN
+void Localization::addRangeEdge(const uwb_driver::UwbRange::ConstPtr& uwb)
+#else
+void Localization::addRangeEdge(const bitcraze_lps_estimator::UwbRange::ConstPtr& uwb)
+#endif
+{
+    auto start = ingest(sensor_type.range, uwb->header.stamp);
+
+    if (flag_multi_range && uwb->antenna > 0)
+    {
+        group_antenna_range(uwb->header, uwb->requester_id, uwb->responder_id, uwb->distance, uwb->distance_err, uwb->antenna, start);
+        return;
+    }
+
+    if (!add_range(uwb->header, uwb->requester_id, uwb->responder_id, uwb->distance, uwb->distance_err, uwb->antenna))
+        return;
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_range && number_measurements > trajectory_length)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+void Localization::group_antenna_range(const std_msgs::Header& header, uint32_t requester_id, uint32_t responder_id, double distance, double distance_err, int antenna, Metrics::Clock::time_point start)
+{
+    // epochs of other responders are interleaved with this one when each antenna ranges every anchor in turn
+    flush_antenna_groups(header.stamp - ros::Duration(antenna_window), start);
+
+    auto key = std::make_pair(requester_id, responder_id);
+
+    auto group = antenna_groups.find(key);
+
+    // an antenna ranging twice starts the next epoch
+    if (group != antenna_groups.end() && std::find(group->second.antennas.begin(), group->second.antennas.end(), antenna) != group->second.antennas.end())
+        flush_antenna_group(key, start);
+
+    auto& epoch = antenna_groups[key];
+
+    if (epoch.distances.empty())
+    {
+        epoch.header = header;
+
+        epoch.requester_id = requester_id;
+    }
+
+    epoch.responder_ids.push_back(responder_id);
+
+    epoch.distances.push_back(distance);
+
+    epoch.distance_errs.push_back(distance_err);
+
+    epoch.antennas.push_back(antenna);
+
+    // complete once every antenna has ranged, otherwise the window closes it
+    if (epoch.antennas.size() >= offsets.size())
+        flush_antenna_group(key, start);
+}
+
+
+void Localization::flush_antenna_groups(ros::Time until, Metrics::Clock::time_point start)
+{
+    std::vector<std::pair<ros::Time, std::pair<uint32_t, uint32_t> > > expired;
+
+    for (auto& group : antenna_groups)
+        if (group.second.header.stamp <= until)
+            expired.push_back(std::make_pair(group.second.header.stamp, group.first));
+
+    std::sort(expired.begin(), expired.end());
+
+    for (auto& group : expired)
+        flush_antenna_group(group.second, start);
+}
+
+
+void Localization::flush_antenna_group(std::pair<uint32_t, uint32_t> key, Metrics::Clock::time_point start)
+{
+    auto group = antenna_groups.find(key);
+
+    if (group == antenna_groups.end())
+        return;
+
+    localization::UwbRangeEpoch epoch;
+
+    std::swap(epoch, group->second);
+
+    antenna_groups.erase(group);
+
+    add_range_epoch(epoch, start);
+}
+
+
+void Localization::flush_antenna_timer(const ros::TimerEvent&)
+{
+    // the last epochs close even when the antennas stop ranging, after the reorder buffer released their ranges
+    ros::Time until = ros::Time::now() - ros::Duration(antenna_window + reorder_latency);
+
+    dispatch([this, until]{flush_antenna_groups(until, Metrics::now());});
+}
+
+
+void Localization::addRangeEpoch(const localization::UwbRangeEpoch::ConstPtr& epoch)
+{
+    auto start = ingest(sensor_type.range, epoch->header.stamp);
+
+    add_range_epoch(*epoch, start);
+}
+
+
+void Localization::add_range_epoch(const localization::UwbRangeEpoch& epoch, Metrics::Clock::time_point start)
+{
+    if (!robots.count(epoch.requester_id))
+    {
+        ROS_WARN("Drop range epoch of ID: %d, not tracked", epoch.requester_id);
+        return;
+    }
+
+    std_msgs::Header header = epoch.header;
+
+    size_t added = 0;
+
+    size_t ranges = std::min(epoch.responder_ids.size(), std::min(epoch.distances.size(), epoch.distance_errs.size()));
+
+    // once converged, only the anchors around the requester take part in the epoch
+    bool select = !anchor_index.empty() && (anchor_radius > 0 || anchor_nearest > 0) && number_measurements > trajectory_length;
+
+    if (select)
+    {
+        auto position = robots.at(epoch.requester_id).last_vertex()->estimate().translation();
+
+        if (anchor_nearest > 0)
+        {
+            // nearest among the anchors that answered, the nearest ones of the site may not be in the epoch
+            std::vector<std::pair<double, uint32_t> > responders;
+
+            for (size_t i = 0; i < ranges; ++i)
+            {
+                auto responder_id = epoch.responder_ids[i];
+
+                if (robots.count(responder_id) && robots.at(responder_id).is_static())
+                    responders.push_back(std::make_pair((robots.at(responder_id).last_vertex()->estimate().translation() - position).squaredNorm(), responder_id));
+            }
+
+            // an anchor ranged by several antennas counts once
+            std::sort(responders.begin(), responders.end());
+
+            responders.erase(std::unique(responders.begin(), responders.end()), responders.end());
+
+            anchor_selection.clear();
+
+            for (size_t i = 0; i < responders.size() && (int)i < anchor_nearest; ++i)
+                anchor_selection.push_back(responders[i].second);
+        }
+        else
+            anchor_index.radius(position, anchor_radius, anchor_selection);
+
+        std::sort(anchor_selection.begin(), anchor_selection.end());
+
+        std::vector<uint32_t> selected;
+
+        for (size_t i = 0; i < ranges; ++i)
+            if (std::binary_search(anchor_selection.begin(), anchor_selection.end(), epoch.responder_ids[i]))
+                selected.push_back(epoch.responder_ids[i]);
+
+        std::sort(selected.begin(), selected.end());
+
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+        // too few anchors of the epoch around a wrong estimate would lock out the ranges that correct it
+        if (selected.size() < 4)
+        {
+            MEASUREMENT_INFO("Use all anchors of the epoch, only %zu around the requester", selected.size());
+
+            select = false;
+        }
+    }
+
+    std::vector<bool> grouped(ranges, false);
+
+    std::vector<double> distances, distance_errs;
+
+    std::vector<int> antennas;
+
+    for (size_t i = 0; i < ranges; ++i)
+    {
+        auto responder_id = epoch.responder_ids[i];
+
+        if (grouped[i])
+            continue;
+
+        if (select && robots.count(responder_id) && robots.at(responder_id).is_static() && !std::binary_search(anchor_selection.begin(), anchor_selection.end(), responder_id))
+        {
+            MEASUREMENT_INFO("Skip range to unselected anchor ID: %d", responder_id);
+            continue;
+        }
+
+        if (i < epoch.stamps.size())
+            header.stamp = epoch.stamps[i];
+
+        int antenna = i < epoch.antennas.size() ? epoch.antennas[i] : 0;
+
+        // ranges of the requester's antennas to the same responder make one multi range edge
+        if (flag_multi_range && antenna > 0)
+        {
+            distances.clear();
+
+            distance_errs.clear();
+
+            antennas.clear();
+
+            for (size_t j = i; j < ranges && j < epoch.antennas.size(); ++j)
+                if (epoch.responder_ids[j] == responder_id && epoch.antennas[j] > 0)
+                {
+                    grouped[j] = true;
+
+                    distances.push_back(epoch.distances[j]);
+
+                    distance_errs.push_back(epoch.distance_errs[j]);
+
+                    antennas.push_back(epoch.antennas[j]);
+                }
+
+            if (distances.size() > 1)
+            {
+                if (add_multi_range(header, epoch.requester_id, responder_id, distances, distance_errs, antennas))
+                    ++added;
+
+                continue;
+            }
+        }
+
+        if (add_range(header, epoch.requester_id, epoch.responder_ids[i], epoch.distances[i], epoch.distance_errs[i], antenna))
+            ++added;
+    }
+
+    if (added == 0)
+        return;
+
+    metrics.record(Metrics::graph, start);
+
+    // one solve for the whole epoch
+    if (publish_range && number_measurements > trajectory_length)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+void Localization::addTdoaEdge(const localization::UwbTdoa::ConstPtr& tdoa)
+{
+    auto start = ingest(sensor_type.range, tdoa->header.stamp);
+
+    if (!robots.count(tdoa->tag_id) || !robots.count(tdoa->anchor_id) || !robots.count(tdoa->reference_id) || robots.at(tdoa->tag_id).is_static())
+    {
+        ROS_WARN("Skip TDoA of tag ID: %d to anchors %d and %d, not tracked", tdoa->tag_id, tdoa->anchor_id, tdoa->reference_id);
+        return;
+    }
+
+    ++number_measurements;
+
+    auto& tag = robots.at(tdoa->tag_id);
+
+    auto vertex_anchor = robots.at(tdoa->anchor_id).last_vertex();
+
+    auto vertex_reference = robots.at(tdoa->reference_id).last_vertex();
+
+    Eigen::Vector3d to_anchor = tag.last_vertex()->estimate().translation() - vertex_anchor->estimate().translation();
+
+    Eigen::Vector3d to_reference = tag.last_vertex()->estimate().translation() - vertex_reference->estimate().translation();
+
+    double innovation = tdoa->distance_difference - (to_anchor.norm() - to_reference.norm());
+
+    bool reject;
+
+    Eigen::Matrix3d covariance;
+
+    if (range_gate.enabled() && predicted_covariance(tdoa->tag_id, tdoa->header.stamp, covariance))
+    {
+        // the difference changes along the difference of the two line of sight directions
+        Eigen::Vector3d gradient = to_anchor.normalized() - to_reference.normalized();
+
+        double variance = gradient.dot(covariance * gradient) + pow(tdoa->distance_difference_err, 2);
+
+        reject = !range_gate.accept(tdoa->tag_id, tdoa->anchor_id, innovation, variance);
+    }
+    else
+        reject = number_measurements > trajectory_length && abs(innovation) > distance_outlier + outlier_margin;
+
+    if (reject)
+    {
+        MEASUREMENT_WARN("Reject TDoA ID: %d to %d measurement: %fm", tdoa->anchor_id, tdoa->reference_id, tdoa->distance_difference);
+        metrics.count(Metrics::rejections);
+        trace.record(Trace::reject, tdoa->anchor_id, tdoa->distance_difference);
+        return;
+    }
+
+    double dt = tdoa->header.stamp.toSec() - tag.last_header().stamp.toSec();
+
+    auto vertex_last = tag.last_vertex();
+
+    auto vertex = tag.new_vertex(sensor_type.range, tdoa->header, optimizer);
+
+    auto edge = new g2o::EdgeSE3TDoA();
+
+    edge->vertices()[0] = vertex;
+
+    edge->vertices()[1] = vertex_anchor;
+
+    edge->vertices()[2] = vertex_reference;
+
+    edge->setMeasurement(tdoa->distance_difference);
+
+    Eigen::MatrixXd covariance_matrix = Eigen::MatrixXd::Zero(1, 1);
+
+    covariance_matrix(0,0) = pow(tdoa->distance_difference_err, 2);
+
+    edge->setInformation(covariance_matrix.inverse());
+
+    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+    add_edge(edge);
+
+    if (tdoa->tag_id != self_id || !add_twist_edge(vertex_last, vertex, tdoa->header.stamp))
+        add_edge(create_range_edge(vertex_last, vertex, 0, pow(robot_max_velocity*dt/3, 2))); //3 sigma priciple
+
+    MEASUREMENT_INFO("added TDoA edge of tag: <%d> on ids: <%d, %d>", tdoa->tag_id, tdoa->anchor_id, tdoa->reference_id);
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_range && number_measurements > trajectory_length)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+bool Localization::add_range(const std_msgs::Header& header, uint32_t requester_id, uint32_t responder_id, double distance, double distance_err, int antenna)
+{
+    if (!robots.count(requester_id) || !robots.count(responder_id))
+    {
+        ROS_WARN("Drop range of ID: %d to %d, not tracked", requester_id, responder_id);
+        return false;
+    }
+
+    ++number_measurements;
+
+    if (!gate_range(header, requester_id, responder_id, distance, distance_err))
+        return false;
+
+    if (knot_interval > 0)
+    {
+        auto edge = create_knot_range_edge(requester_id, responder_id, header.stamp, distance, pow(distance_err, 2));
+
+        if (edge == NULL)
+        {
+            MEASUREMENT_WARN("Drop range ID: %d older than the window", responder_id);
+            return false;
+        }
+
+        if(antenna > 0)
+            edge->setVertexOffset(0, offsets[antenna-1]);
+
+        add_edge(edge);
+
+        MEASUREMENT_INFO("added knot range edge on id: <%d>", responder_id);
+
+        return true;
+    }
+
+    double dt_requester = header.stamp.toSec() - robots.at(requester_id).last_header().stamp.toSec();
+    double dt_responder = header.stamp.toSec() - robots.at(responder_id).last_header().stamp.toSec();
+    double distance_cov = pow(distance_err, 2);
+    double cov_requester = pow(robot_max_velocity*dt_requester/3, 2); //3 sigma priciple
+
+    auto vertex_last_requester = robots.at(requester_id).last_vertex();
+    auto vertex_last_responder = robots.at(responder_id).last_vertex();
+    auto vertex_responder = robots.at(responder_id).new_vertex(sensor_type.range, header, optimizer);
+     
+    auto frame_id = robots.at(requester_id).last_header().frame_id;
+
+    if( (frame_id.find(header.frame_id)!=string::npos) || (frame_id.find("none")!=string::npos))
+    {    
+        auto vertex_requester = robots.at(requester_id).new_vertex(sensor_type.range, header, optimizer);
+
+        auto edge = create_range_edge(vertex_requester, vertex_responder, distance, distance_cov);
+
+        if(antenna > 0)
+            edge->setVertexOffset(0, offsets[antenna-1]);
+        
+        add_edge(edge);
+
+        if (requester_id != self_id || !add_twist_edge(vertex_last_requester, vertex_requester, header.stamp))
+        {
+            auto edge_requester_range = create_range_edge(vertex_last_requester, vertex_requester, 0, cov_requester);
+
+            add_edge(edge_requester_range); 
+        }
+
+        if(antenna > 0)
+            MEASUREMENT_INFO("added two requester range edge on id: <%d> with offsets %d <%.2f, %.2f, %.2f> at %.3f;",
+                responder_id, antenna-1, offsets[antenna-1](0,3), offsets[antenna-1](1,3), offsets[antenna-1](2,3), dt_requester);
+        else
+            MEASUREMENT_INFO("added two requester range edge on id: <%d> ", responder_id);
+    }
+    else
+    {
+        auto edge = create_range_edge(vertex_last_requester, vertex_responder, distance, distance_cov + cov_requester);
+
+        add_edge(edge); // decrease computation
+
+        MEASUREMENT_INFO("added requester edge with id: <%d>", responder_id);
+
+
+    }
+
+
+    if (!robots.at(responder_id).is_static())
+    {
+        if (responder_id != self_id || !add_twist_edge(vertex_last_responder, vertex_responder, header.stamp))
+        {
+            double cov_responder = pow(robot_max_velocity*dt_responder/3, 2); //3 sigma priciple
+
+            auto edge_responder_range = create_range_edge(vertex_last_responder, vertex_responder, 0, cov_responder);
+
+            add_edge(edge_responder_range);
+        }
+
+        MEASUREMENT_INFO("added responder trajectory edge;");
+    }
+
+    return true;
+}
+
+
+bool Localization::add_multi_range(const std_msgs::Header& header, uint32_t requester_id, uint32_t responder_id,
+                                   const std::vector<double>& distances, const std::vector<double>& distance_errs, const std::vector<int>& antennas)
+{
+    if (!robots.count(requester_id) || !robots.count(responder_id))
+    {
+        ROS_WARN("Drop multi range of ID: %d to %d, not tracked", requester_id, responder_id);
+        return false;
+    }
+
+    // knots interpolate each range at its own time
+    if (knot_interval > 0)
+    {
+        bool added = false;
+
+        for (size_t i = 0; i < distances.size(); ++i)
+            added = add_range(header, requester_id, responder_id, distances[i], distance_errs[i], antennas[i]) || added;
+
+        return added;
+    }
+
+    auto edge = new g2o::EdgeSE3MultiRange();
+
+    size_t i = 0;
+
+    for (; i < distances.size() && edge->size() < g2o::EdgeSE3MultiRange::Antennas; ++i)
+    {
+        ++number_measurements;
+
+        if (antennas[i] < 1 || antennas[i] > (int)offsets.size())
+        {
+            ROS_WARN("No offset for antenna: %d", antennas[i]);
+            continue;
+        }
+
+        if (gate_range(header, requester_id, responder_id, distances[i], distance_errs[i]))
+            edge->addRange(offsets[antennas[i]-1], distances[i], 1.0/pow(distance_errs[i], 2));
+    }
+
+    if (edge->size() == 0)
+    {
+        delete edge;
+        return false;
+    }
+
+    double dt_requester = header.stamp.toSec() - robots.at(requester_id).last_header().stamp.toSec();
+    double dt_responder = header.stamp.toSec() - robots.at(responder_id).last_header().stamp.toSec();
+
+    auto vertex_last_requester = robots.at(requester_id).last_vertex();
+    auto vertex_last_responder = robots.at(responder_id).last_vertex();
+    auto vertex_responder = robots.at(responder_id).new_vertex(sensor_type.range, header, optimizer);
+    auto vertex_requester = robots.at(requester_id).new_vertex(sensor_type.range, header, optimizer);
+
+    // one requester vertex for all antennas of the epoch
+    edge->vertices()[0] = vertex_requester;
+
+    edge->vertices()[1] = vertex_responder;
+
+    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+    add_edge(edge);
+
+    if (requester_id != self_id || !add_twist_edge(vertex_last_requester, vertex_requester, header.stamp))
+        add_edge(create_range_edge(vertex_last_requester, vertex_requester, 0, pow(robot_max_velocity*dt_requester/3, 2)));
+
+    if (!robots.at(responder_id).is_static())
+        if (responder_id != self_id || !add_twist_edge(vertex_last_responder, vertex_responder, header.stamp))
+            add_edge(create_range_edge(vertex_last_responder, vertex_responder, 0, pow(robot_max_velocity*dt_responder/3, 2)));
+
+    MEASUREMENT_INFO("added multi range edge on id: <%d> with %d antennas", responder_id, edge->size());
+
+    // the edge is full, the remaining antennas still count as single ranges
+    for (; i < distances.size(); ++i)
+        if (antennas[i] < 1 || antennas[i] > (int)offsets.size())
+            ROS_WARN("No offset for antenna: %d", antennas[i]);
+        else
+            add_range(header, requester_id, responder_id, distances[i], distance_errs[i], antennas[i]);
+
+    return true;
+}
+
+
+inline bool Localization::gate_range(const std_msgs::Header& header, uint32_t requester_id, uint32_t responder_id, double distance, double distance_err)
+{
+    // kept for relocalization, rejections included since the estimate may be the wrong one
+    if (requester_id == self_id && robots.at(responder_id).is_static())
+        recent_ranges[responder_id] = RecentRange{header.stamp, distance, distance_err};
+    else if (responder_id == self_id && robots.at(requester_id).is_static())
+        recent_ranges[requester_id] = RecentRange{header.stamp, distance, distance_err};
+
+    Eigen::Vector3d line_of_sight = robots.at(requester_id).last_vertex()->estimate().translation() -
+                                    robots.at(responder_id).last_vertex()->estimate().translation();
+
+    double distance_estimation = line_of_sight.norm();
+
+    // a range beyond the anchor radius can't come from the requester's current region, judged on the measurement
+    // alone since the estimate may be the wrong one
+    bool out_of_region = anchor_radius > 0 && robots.at(responder_id).is_static() && distance > anchor_radius;
+
+    bool reject = number_measurements > trajectory_length && out_of_region;
+
+    Eigen::Matrix3d covariance_requester, covariance_responder;
+
+    // the fixed distance gate stays until anchor ranges bound the predicted covariance of both sides
+    bool bounded = range_gate.enabled() && predicted_covariance(requester_id, header.stamp, covariance_requester)
+                                        && predicted_covariance(responder_id, header.stamp, covariance_responder);
+
+    if (!bounded)
+        reject = reject || (number_measurements > trajectory_length && abs(distance_estimation-distance) > distance_outlier + outlier_margin);
+    else if (!reject && distance_estimation > 0)
+    {
+        // innovation normalized by the predicted range variance
+        Eigen::Vector3d direction = line_of_sight / distance_estimation;
+
+        Eigen::Matrix3d covariance = covariance_requester + covariance_responder;
+
+        double variance = direction.dot(covariance * direction) + pow(distance_err, 2);
+
+        reject = !range_gate.accept(requester_id, responder_id, distance - distance_estimation, variance);
+    }
+
+    if (reject)
+    {
+        MEASUREMENT_WARN("Reject ID: %d measurement: %fm", responder_id, distance);
+        metrics.count(Metrics::rejections);
+        trace.record(Trace::reject, responder_id, distance);
+        return false;
+    }
+
+    return true;
+}
+
+#ifdef RELATIVE_LOCALIZATION
+void Localization::addRLRangeEdge(const uwb_reloc::uwbTalkData::ConstPtr& uwb)
+{
+    auto start = ingest(sensor_type.range, uwb->time_stamp);
+
+    std_msgs::Header RLheader;
+    RLheader.stamp  = uwb->time_stamp;
+    RLheader.frame_id = "uwb";
+
+    double dt_requester = uwb->time_stamp.toSec() - robots.at(uwb->rqstrId).last_header().stamp.toSec();
+    double dt_responder = uwb->time_stamp.toSec() - robots.at(uwb->rspdrId).last_header().stamp.toSec();
+
+    double distance_cov = pow(0.054, 2);
+    double cov_requester = pow(robot_max_velocity*dt_requester/3, 2); //3 sigma priciple
+    double cov_responder = pow(robot_max_velocity*dt_responder/3, 2); //3 sigma priciple
+
+    auto vertex_last_requester = robots.at(uwb->rqstrId).last_vertex();
+    auto vertex_last_responder = robots.at(uwb->rspdrId).last_vertex();
+
+    auto vertex_requester = robots.at(uwb->rqstrId).new_vertex(sensor_type.range, RLheader, optimizer);
+    auto vertex_responder = robots.at(uwb->rspdrId).new_vertex(sensor_type.range, RLheader, optimizer);
+
+    auto edge = create_range_edge(vertex_requester, vertex_responder, uwb->d, distance_cov);   
+    add_edge(edge);
+
+    if (!robots.at(uwb->rspdrId).is_static())
+    {
+        auto edge_responder_range = create_range_edge(vertex_last_responder, vertex_responder, 0, cov_responder);
+        add_edge(edge_responder_range);
+        MEASUREMENT_INFO("added responder trajectory edge;");
+    }
+
+    // add EdgeSE3 using velocity information
+    if (!robots.at(uwb->rqstrId).is_static())
+    {
+        g2o::EdgeSE3 *edge_requester = new g2o::EdgeSE3();
+        edge_requester->vertices()[0] = vertex_last_requester;
+        edge_requester->vertices()[1] = vertex_requester;
+
+        Eigen::Isometry3d measurement;
         measurement.setIdentity();        
         measurement.translate(dt_requester*g2o::Vector3D(uwb->rqstr_vx, uwb->rqstr_vy, uwb->rqstr_vz));
 
-        edge_requester->setMeasurement(measurement);
+        edge_requester->setMeasurement(measurement);
+
+        Eigen::MatrixXd requester_SE3information = MatrixXd::Zero(6,6);
+        requester_SE3information(0,0) = 1.0/cov_requester;
+        requester_SE3information(1,1) = 1.0/cov_requester;
+        requester_SE3information(2,2) = 1.0/cov_requester;
+
+        edge_requester->setInformation(requester_SE3information);
+        add_edge(edge_requester);
+    }
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_relative_range)
+    {
+        solve();
+        publish();
+    }
+}
+#endif
+
+void Localization::addTwistEdge(const geometry_msgs::TwistWithCovarianceStamped::ConstPtr& twist_)
+{
+    auto start = ingest(sensor_type.twist, twist_->header.stamp);
+
+    tf::vectorMsgToEigen(twist_->twist.twist.linear, twist_linear);
+
+    tf::vectorMsgToEigen(twist_->twist.twist.angular, twist_angular);
+
+    twist_covariance = Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor> >(twist_->twist.covariance.data());
+
+    if (twist_stamp.isZero())
+        twist_stamp = twist_->header.stamp;
+    else
+        integrate_twist(twist_->header.stamp);
+
+    // with preintegration and no keyframe policy, the range vertices collect the twist motion
+    if (flag_twist_preintegration && !keyframe.enabled())
+        return;
+
+    if (twist_preintegration.size() == 0 || !keyframe.check(twist_preintegration.delta(), twist_preintegration.duration()))
+        return;
+
+    auto last_vertex = robots.at(self_id).last_vertex();
+
+    auto new_vertex = robots.at(self_id).new_vertex(sensor_type.twist, twist_->header, optimizer);
+
+    add_twist_edge(last_vertex, new_vertex, twist_->header.stamp);
+
+    MEASUREMENT_INFO("added twist edge id: %d", twist_->header.seq);
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_twist)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+void Localization::addLidarEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& pose_cov_)
+{
+    auto start = ingest(sensor_type.general, pose_cov_->header.stamp);
+
+    if (robots.at(self_id).last_header().frame_id.find(pose_cov_->header.frame_id) == string::npos)
+    {
+        robots.at(self_id).append_last_header(pose_cov_->header.frame_id);
+
+        auto last_vertex = robots.at(self_id).last_vertex(sensor_type.range);
+
+        Eigen::Isometry3d current_pose = Eigen::Isometry3d::Identity();
+
+        current_pose = last_vertex->estimate();
+
+        current_pose(2, 3) = pose_cov_->pose.pose.position.z;
+
+        last_vertex->setEstimate(current_pose);
+
+        robots.at(self_id).mark_changed(robots.at(self_id).last_index() - robots.at(self_id).last_index(sensor_type.range) + 1);
+
+        Eigen::MatrixXd  information = Eigen::MatrixXd::Zero(6,6);
+        information(2,2)= 1/0.05;
+        
+        g2o::EdgeSE3Prior* edgeprior = new g2o::EdgeSE3Prior();
+        edgeprior->setInformation(information);
+        edgeprior->vertices()[0]= last_vertex; 
+        edgeprior->setMeasurement(current_pose); 
+        edgeprior->setParameterId(0,0);
+        add_edge(edgeprior);
+
+        MEASUREMENT_INFO("added lidar edge id: %d", pose_cov_->header.seq);
+    }
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_lidar)
+    {
+        solve();
+        publish();
+    }
+}
+
+
+void Localization::addImuEdge(const sensor_msgs::Imu::ConstPtr& Imu_)
+{
+    auto start = ingest(sensor_type.imu, Imu_->header.stamp);
+
+    auto vertex = robots.at(self_id).last_vertex(sensor_type.range);
+
+    auto vertex_header = robots.at(self_id).last_header(sensor_type.range);
+
+    Eigen::Vector3d angular(Imu_->angular_velocity.x, Imu_->angular_velocity.y, Imu_->angular_velocity.z);
+
+    Preintegration::Matrix6d covariance = Preintegration::Matrix6d::Zero();
+
+    if (Imu_->angular_velocity_covariance[0] > 0)
+    {
+        Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor> > gyroscope_cov(Imu_->angular_velocity_covariance.data());
+        covariance.block<3,3>(3,3) = gyroscope_cov;
+    }
+    else
+        covariance.block<3,3>(3,3) = Eigen::Matrix3d::Identity() * pow(gyroscope_noise, 2);
+
+    auto index = robots.at(self_id).last_index(sensor_type.range);
+
+    if (imu_key_index == Robot::none)
+    {
+        imu_key_index = index;
+        imu_header = Imu_->header;
+    }
+
+    double begin = imu_header.stamp.toSec();
+
+    if (index != imu_key_index)
+    {
+        auto imu_key_vertex = robots.at(self_id).vertex_at(imu_key_index);
+
+        // a new range vertex appeared, close the factor at its timestamp
+        double dt_key = vertex_header.stamp.toSec() - begin;
+
+        imu_preintegration.integrate(Eigen::Vector3d::Zero(), angular, covariance, dt_key);
+
+        if (imu_preintegration.size() > 0 && imu_key_vertex != NULL)
+        {
+            Eigen::Isometry3d current_pose = vertex->estimate();
+
+            current_pose.linear() = (imu_key_vertex->estimate() * imu_preintegration.delta()).linear();
+
+            vertex->setEstimate(current_pose);
+
+            add_edge(create_se3_edge_from_preintegration(imu_key_vertex, vertex, imu_preintegration));
+
+            MEASUREMENT_INFO("added IMU preintegration edge with %d samples over %.3fs;", imu_preintegration.size(), imu_preintegration.duration());
+        }
+
+        // absolute attitude from the IMU filter, once per range vertex
+        if (Imu_->orientation_covariance[0] > 0)
+        {
+            Eigen::Isometry3d current_pose = Eigen::Isometry3d::Identity();
+
+            current_pose.rotate(Quaterniond(Imu_->orientation.w, Imu_->orientation.x, Imu_->orientation.y, Imu_->orientation.z));
+
+            current_pose.translation() = vertex->estimate().translation();
+
+            vertex->setEstimate(current_pose);
+
+            Eigen::MatrixXd  information = Eigen::MatrixXd::Zero(6,6);
+            information(3,3)= 1.0/Imu_->orientation_covariance[0];
+            information(4,4)= 1.0/Imu_->orientation_covariance[4];
+            information(5,5)= 1.0/Imu_->orientation_covariance[8];// roll, pitch, yaw
+
+            g2o::EdgeSE3Prior* edgeprior = new g2o::EdgeSE3Prior();
+            edgeprior->setInformation(information);
+            edgeprior->vertices()[0]= vertex;
+            edgeprior->setMeasurement(current_pose);
+            edgeprior->setParameterId(0,0);
+            add_edge(edgeprior);
+
+            MEASUREMENT_INFO("added IMU edge id: %d", Imu_->header.seq);
+        }
+
+        // the range vertex is often not the newest one, reconvert it for the path before the next solve
+        robots.at(self_id).mark_changed(robots.at(self_id).last_index() - index + 1);
+
+        imu_preintegration.reset();
+
+        imu_key_index = index;
+
+        begin = std::max(begin, vertex_header.stamp.toSec());
+    }
+
+    imu_preintegration.integrate(Eigen::Vector3d::Zero(), angular, covariance, Imu_->header.stamp.toSec() - begin);
+
+    imu_header = Imu_->header;
+
+    metrics.record(Metrics::graph, start);
+
+    if (publish_imu)
+    {   
+        solve();
+        publish();
+    }
+}
+
+
+
+void Localization::configCallback(localization::localizationConfig &config, uint32_t level)
+{
+    ROS_WARN("Get publish_optimized_poses: %s", config.publish_optimized_poses? "ture":"false");
+
+    if (config.publish_optimized_poses)
+    {
+        std::vector<geometry_msgs::PoseStamped> poses;
+
+        {
+            std::lock_guard<std::mutex> lock(core_mutex);
+
+            auto path = robots.at(self_id).vertices2path();
+
+            poses.assign(path->poses.begin() + fixed_lag_index(path), path->poses.end());
+        }
+
+        // paced republishing runs on its own thread, ingestion and solving go on meanwhile
+        if (republisher.joinable())
+            republisher.join();
+
+        republisher = std::thread([this, poses]
+        {
+            ROS_WARN("Publishing Optimized poses");
+
+            for (auto& pose : poses)
+            {
+                pose_optimized_pub.publish(pose);
+
+                usleep(10000);
+            }
+            ROS_WARN("Published. Done");
+        });
+    }
+}
+
+
+void Localization::dispatch(const Task& task)
+{
+    if (!threaded)
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+
+        if (tasks.size() >= task_capacity)
+        {
+            ++dropped_tasks;
+            return;
+        }
+
+        tasks.push_back(task);
+    }
+
+    task_condition.notify_one();
+}
+
+
+void Localization::run_worker()
+{
+    std::unique_lock<std::mutex> lock(task_mutex);
+
+    while (true)
+    {
+        task_condition.wait(lock, [this]{return !tasks.empty() || !running;});
+
+        if (tasks.empty())
+            break;
+
+        Task task = tasks.front();
+
+        tasks.pop_front();
+
+        lock.unlock();
+
+        {
+            std::lock_guard<std::mutex> core_lock(core_mutex);
+
+            task();
+
+            // the last queued measurement didn't solve, catch up with the deferred ones
+            if (deferred && !deferrable())
+            {
+                deferred = false;
+                solve();
+                publish();
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+
+bool Localization::deferrable()
+{
+    if (!threaded)
+        return false;
+
+    std::lock_guard<std::mutex> lock(task_mutex);
+
+    // more measurements are queued, solve and publish after them instead
+    if (!tasks.empty())
+        deferred = true;
+
+    return !tasks.empty();
+}
+
+
+inline Metrics::Clock::time_point Localization::ingest(unsigned char type, ros::Time stamp)
+{
+    trace.record(Trace::arrival, type, stamp.toSec());
+
+    metrics.count(Metrics::measurements);
+
+    // transport and queueing delay of the message
+    metrics.record(Metrics::ingest, (ros::Time::now() - stamp).toSec());
+
+    return Metrics::now();
+}
+
+
+inline void Localization::edge_chi2(double& range, double& motion, double& se3, double& prior)
+{
+    range = motion = se3 = prior = 0;
+
+    for (auto edge : optimizer.activeEdges())
+    {
+        auto range_edge = dynamic_cast<g2o::EdgeSE3Range*>(edge);
+
+        // a zero range is the motion model, not a measurement
+        if (range_edge != NULL && range_edge->measurement() == 0)
+            motion += edge->chi2();
+        else if (dynamic_cast<g2o::EdgeSE3Prior*>(edge) != NULL)
+            prior += edge->chi2();
+        else if (dynamic_cast<g2o::EdgeSE3*>(edge) != NULL)
+            se3 += edge->chi2();
+        else
+            range += edge->chi2();
+    }
+}
+
+
+inline void Localization::add_edge(g2o::OptimizableGraph::Edge* edge)
+{
+    optimizer.addEdge(edge);
+
+    // prediction residual of the new measurement at the current estimate
+    edge->computeError();
+
+    pending_impact += edge->chi2();
+
+    trace.record(Trace::enqueue, edge->dimension(), edge->chi2());
+}
+
+
+inline g2o::EdgeSE3* Localization::create_se3_edge_from_preintegration(g2o::VertexSE3* vetex1, g2o::VertexSE3* vetex2, Preintegration& preintegration)
+{
+    g2o::EdgeSE3 *edge = new g2o::EdgeSE3();
+
+    edge->vertices()[0] = vetex1;
+
+    edge->vertices()[1] = vetex2;
+
+    edge->setMeasurement(preintegration.delta());
+
+    edge->setInformation(preintegration.information());
+
+    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+    return edge;
+}
+
+
+inline bool Localization::add_twist_edge(g2o::VertexSE3* last_vertex, g2o::VertexSE3* vertex, ros::Time stamp)
+{
+    // the held twist also covers the time from its message to this vertex
+    if (!twist_stamp.isZero())
+        integrate_twist(stamp);
+
+    // nothing to integrate before the first twist or for a vertex older than it
+    if (twist_preintegration.size() == 0)
+        return false;
+
+    vertex->setEstimate(last_vertex->estimate() * twist_preintegration.delta());
+
+    add_edge(create_se3_edge_from_preintegration(last_vertex, vertex, twist_preintegration));
+
+    MEASUREMENT_INFO("added twist preintegration edge with %d samples over %.3fs;", twist_preintegration.size(), twist_preintegration.duration());
+
+    twist_preintegration.reset();
+
+    return true;
+}
+
+
+inline void Localization::integrate_twist(ros::Time stamp)
+{
+    double dt = stamp.toSec() - twist_stamp.toSec();
+
+    if (dt <= 0)
+        return;
+
+    twist_preintegration.integrate(twist_linear, twist_angular, twist_covariance, dt);
+
+    twist_stamp = stamp;
+}
+
+
+inline g2o::EdgeSE3RangeKnot* Localization::create_knot_range_edge(uint32_t requester_id, uint32_t responder_id, ros::Time stamp, double distance, double covariance)
+{
+    std::vector<g2o::VertexSE3*> vertices_requester, vertices_responder;
+
+    double alpha_requester, alpha_responder;
+
+    if (!knots(requester_id, stamp, vertices_requester, alpha_requester) || !knots(responder_id, stamp, vertices_responder, alpha_responder))
+        return NULL;
+
+    auto edge = new g2o::EdgeSE3RangeKnot();
+
+    edge->setKnots(vertices_requester.size(), alpha_requester, vertices_responder.size(), alpha_responder);
+
+    for (size_t i = 0; i < vertices_requester.size(); ++i)
+        edge->vertices()[i] = vertices_requester[i];
+
+    for (size_t i = 0; i < vertices_responder.size(); ++i)
+        edge->vertices()[vertices_requester.size()+i] = vertices_responder[i];
+
+    edge->setMeasurement(distance);
+
+    Eigen::MatrixXd covariance_matrix = Eigen::MatrixXd::Zero(1, 1);
+
+    covariance_matrix(0,0) = covariance;
+
+    edge->setInformation(covariance_matrix.inverse());
+
+    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+    return edge;
+}
+
+
+inline bool Localization::knots(uint32_t id, ros::Time stamp, std::vector<g2o::VertexSE3*>& vertices, double& alpha)
+{
+    alpha = 0;
+
+    if (robots.at(id).is_static())
+    {
+        vertices.push_back(robots.at(id).last_vertex());
+        return true;
+    }
+
+    // the first measurement starts the knot sequence
+    if (robots.at(id).last_header().stamp.isZero())
+    {
+        std_msgs::Header header = robots.at(id).last_header();
+        header.stamp = stamp;
+        header.frame_id = "knot";
+        robots.at(id).update_last_header(sensor_type.range, header);
+    }
+
+    // append knots at a fixed rate until the newest one is at or after the measurement
+    while (robots.at(id).last_header().stamp < stamp)
+    {
+        auto last_vertex = robots.at(id).last_vertex();
+
+        std_msgs::Header header = robots.at(id).last_header();
+
+        double dt = knot_interval;
+
+        // after a long gap, jump with a single knot instead of flooding the window
+        if ((stamp - header.stamp).toSec() > knot_interval * trajectory_length)
+        {
+            dt = (stamp - header.stamp).toSec();
+            header.stamp = stamp;
+        }
+        else
+            header.stamp += ros::Duration(knot_interval);
+
+        header.frame_id = "knot";
+
+        auto vertex = robots.at(id).new_vertex(sensor_type.range, header, optimizer);
+
+        if (id != self_id || !add_twist_edge(last_vertex, vertex, header.stamp))
+            add_edge(create_range_edge(last_vertex, vertex, 0, pow(robot_max_velocity*dt/3, 2)));
+    }
+
+    // a late measurement goes between the knots around its own stamp, not the newest ones
+    g2o::VertexSE3 *before, *after;
+
+    alpha = robots.at(id).bracket(stamp, before, after);
+
+    if (alpha < 0)
+        return false;
+
+    vertices.push_back(before);
+
+    vertices.push_back(after);
+
+    return true;
+}
+
+
+inline bool Localization::predicted_covariance(uint32_t id, ros::Time stamp, Eigen::Matrix3d& covariance)
+{
+    auto& robot = robots.at(id);
+
+    if (robot.is_static())
+    {
+        covariance.setZero();
+        return true;
+    }
+
+    // the marginal of the last solve, grown by the motion model since
+    if (id == self_id && covariance_valid)
+    {
+        covariance = pose_covariance.topLeftCorner<3,3>() + Eigen::Matrix3d::Identity() * pow(robot_max_velocity*(stamp - covariance_stamp).toSec()/3, 2);
+        return true;
+    }
+
+    // otherwise the information of the ranges to fixed vertices over the newest vertices, a GDOP-like bound;
+    // the small prior keeps directions without ranges uncertain instead of singular
+    Eigen::Matrix3d information = Eigen::Matrix3d::Identity() * 1e-6;
+
+    bool bounded = false;
+
+    g2o::HyperGraph::VertexSet vertices;
+
+    robot.tail(gate_window, vertices);
+
+    for (auto v : vertices)
+    {
+        auto vertex = static_cast<g2o::VertexSE3*>(v);
+
+        for (auto e : vertex->edges())
+        {
+            auto tdoa = dynamic_cast<g2o::EdgeSE3TDoA*>(e);
+
+            if (tdoa != NULL && tdoa->vertices()[0] == vertex)
+            {
+                auto anchor = static_cast<g2o::VertexSE3*>(tdoa->vertices()[1]);
+
+                auto reference = static_cast<g2o::VertexSE3*>(tdoa->vertices()[2]);
+
+                Eigen::Vector3d gradient = (vertex->estimate().translation() - anchor->estimate().translation()).normalized() -
+                                           (vertex->estimate().translation() - reference->estimate().translation()).normalized();
+
+                information += tdoa->information()(0,0) * gradient * gradient.transpose();
+
+                bounded = true;
+
+                continue;
+            }
+
+            // one row per antenna, each along the line of sight of its own offset
+            auto multi = dynamic_cast<g2o::EdgeSE3MultiRange*>(e);
+
+            if (multi != NULL)
+            {
+                auto anchor = static_cast<g2o::VertexSE3*>(multi->vertices()[1]);
+
+                if (multi->vertices()[0] != vertex || !anchor->fixed())
+                    continue;
+
+                for (int i = 0; i < multi->size(); ++i)
+                {
+                    Eigen::Vector3d direction = (vertex->estimate() * multi->offset[i]).translation() - anchor->estimate().translation();
+
+                    if (direction.norm() < 1e-6)
+                        continue;
+
+                    information += multi->information()(i,i) * direction.normalized() * direction.normalized().transpose();
+
+                    bounded = true;
+                }
+
+                continue;
+            }
+
+            // a knot range counts once, at the newest knot of the moving side
+            auto knot = dynamic_cast<g2o::EdgeSE3RangeKnot*>(e);
+
+            if (knot != NULL)
+            {
+                g2o::VertexSE3* anchor = NULL;
+
+                g2o::VertexSE3* newest = NULL;
+
+                for (auto k : knot->vertices())
+                    if (static_cast<g2o::VertexSE3*>(k)->fixed())
+                        anchor = static_cast<g2o::VertexSE3*>(k);
+                    else
+                        newest = static_cast<g2o::VertexSE3*>(k);
+
+                if (anchor == NULL || newest != vertex)
+                    continue;
+
+                Eigen::Vector3d direction = vertex->estimate().translation() - anchor->estimate().translation();
+
+                if (direction.norm() < 1e-6)
+                    continue;
+
+                information += knot->information()(0,0) * direction.normalized() * direction.normalized().transpose();
+
+                bounded = true;
+
+                continue;
+            }
+
+            auto edge = dynamic_cast<g2o::EdgeSE3Range*>(e);
+
+            if (edge == NULL)
+                continue;
+
+            auto other = static_cast<g2o::VertexSE3*>(edge->vertices()[edge->vertices()[0] == vertex ? 1 : 0]);
+
+            if (!other->fixed())
+                continue;
+
+            Eigen::Vector3d direction = vertex->estimate().translation() - other->estimate().translation();
+
+            double norm = direction.norm();
+
+            if (norm < 1e-6)
+                continue;
+
+            direction /= norm;
+
+            information += edge->information()(0,0) * direction * direction.transpose();
+
+            bounded = true;
+        }
+    }
+
+    double dt = (stamp - robot.last_header().stamp).toSec();
 
-        Eigen::MatrixXd requester_SE3information = MatrixXd::Zero(6,6);
-        requester_SE3information(0,0) = 1.0/cov_requester;
-        requester_SE3information(1,1) = 1.0/cov_requester;
-        requester_SE3information(2,2) = 1.0/cov_requester;
+    covariance = information.inverse() + Eigen::Matrix3d::Identity() * pow(robot_max_velocity*dt/3, 2); //3 sigma priciple
 
-        edge_requester->setInformation(requester_SE3information);
-        optimizer.addEdge(edge_requester);
-    }
+    return bounded;
+}
 
-    if (publish_relative_range)
-    {
-        solve();
-        publish();
-    }
+
+inline void Localization::add_prior(g2o::VertexSE3* vertex, double sigma_translation, double sigma_rotation)
+{
+    Eigen::MatrixXd information = Eigen::MatrixXd::Zero(6,6);
+    information.block<3,3>(0,0) = Eigen::Matrix3d::Identity() / pow(sigma_translation, 2);
+    information.block<3,3>(3,3) = Eigen::Matrix3d::Identity() / pow(sigma_rotation, 2);
+
+    g2o::EdgeSE3Prior* edgeprior = new g2o::EdgeSE3Prior();
+    edgeprior->setInformation(information);
+    edgeprior->vertices()[0] = vertex;
+    edgeprior->setMeasurement(vertex->estimate());
+    edgeprior->setParameterId(0,0);
+    add_edge(edgeprior);
 }
-#endif
 
-void Localization::addTwistEdge(const geometry_msgs::TwistWithCovarianceStamped::ConstPtr& twist_)
+
+inline g2o::EdgeSE3Range* Localization::create_range_edge(g2o::VertexSE3* vertex1, g2o::VertexSE3* vertex2, double distance, double covariance)
 {
-    geometry_msgs::TwistWithCovarianceStamped twist(*twist_);
+    auto edge = new g2o::EdgeSE3Range();
 
-    double dt = twist.header.stamp.toSec() - robots.at(self_id).last_header().stamp.toSec();
+    edge->vertices()[0] = vertex1;
 
-    auto last_vertex = robots.at(self_id).last_vertex();
+    edge->vertices()[1] = vertex2;
 
-    auto new_vertex = robots.at(self_id).new_vertex(sensor_type.twist, twist.header, optimizer);
+    edge->setMeasurement(distance);
 
-    auto edge = create_se3_edge_from_twist(last_vertex, new_vertex, twist.twist, dt);
+    Eigen::MatrixXd covariance_matrix = Eigen::MatrixXd::Zero(1, 1);
 
-    optimizer.addEdge(edge);
+    covariance_matrix(0,0) = covariance;
 
-    ROS_INFO("added twist edge id: %d", twist.header.seq);
+    edge->setInformation(covariance_matrix.inverse());
 
-    if (publish_twist)
-    {
-        solve();
-        publish();
-    }
+    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+
+    return edge;
 }
 
 
-void Localization::addLidarEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& pose_cov_)
+inline size_t Localization::fixed_lag_index(nav_msgs::Path* path)
 {
-    if (robots.at(self_id).last_header().frame_id.find(pose_cov_->header.frame_id) == string::npos)
-    {
-        robots.at(self_id).append_last_header(pose_cov_->header.frame_id);
+    if (fixed_lag <= 0)
+        return path->poses.size()/2;
 
-        auto last_vertex = robots.at(self_id).last_vertex(sensor_type.range);
+    // newest pose that is at least fixed_lag behind the newest vertex
+    ros::Time target = path->header.stamp - ros::Duration(fixed_lag);
 
-        Eigen::Isometry3d current_pose = Eigen::Isometry3d::Identity();
+    for (size_t i = path->poses.size(); i > 0; --i)
+        if (path->poses[i-1].header.stamp <= target)
+            return i-1;
 
-        current_pose = last_vertex->estimate();
+    return 0;
+}
 
-        current_pose(2, 3) = pose_cov_->pose.pose.position.z;
 
-        last_vertex->setEstimate(current_pose);
+void Localization::set_file()
+{
+    set_file(std::vector<double>());
+}
 
-        Eigen::MatrixXd  information = Eigen::MatrixXd::Zero(6,6);
-        information(2,2)= 1/0.05;
-        
-        g2o::EdgeSE3Prior* edgeprior = new g2o::EdgeSE3Prior();
-        edgeprior->setInformation(information);
-        edgeprior->vertices()[0]= last_vertex; 
-        edgeprior->setMeasurement(current_pose); 
-        edgeprior->setParameterId(0,0);
-        optimizer.addEdge(edgeprior);
 
-        ROS_INFO("added lidar edge id: %d", pose_cov_->header.seq);
-    }
+void Localization::set_file(std::vector<double> antennaOffset)
+{
+    flag_save_file = true;
+    char s[30];
+    struct tm tim;
+    time_t now;
+    now = time(NULL);
+    tim = *(localtime(&now));
+    strftime(s,30,"_%Y_%b_%d_%H_%M_%S",&tim);
+    string extension = flag_binary_log ? ".bin" : ".txt";
+    realtime_filename = name_prefix+"_realtime" + string(s) + extension;
+    optimized_filename = name_prefix+"_optimized" + string(s) + extension;
 
-    if (publish_lidar)
+    std::ostringstream comment;
+    comment<<"iteration_max:"<<iteration_max<<"\n";
+    comment<<"trajectory_length:"<<trajectory_length<<"\n";
+    comment<<"maximum_velocity:"<<robot_max_velocity<<"\n";
+
+    if (!realtime_logger.open(realtime_filename, flag_binary_log, comment.str()))
+        ROS_ERROR("Can't open log file: %s", realtime_filename.c_str());
+
+    if (antennaOffset.size() > 0)
     {
-        solve();
-        publish();
+        comment<<"antenna offsets: ";
+        for(unsigned int i = 0; i < antennaOffset.size() - 1; i++)
+            comment << antennaOffset[i] << ",";
+        comment << antennaOffset[antennaOffset.size()-1] << "\n";
     }
-}
 
+    if (!optimized_logger.open(optimized_filename, flag_binary_log, comment.str()))
+        ROS_ERROR("Can't open log file: %s", optimized_filename.c_str());
 
-void Localization::addImuEdge(const sensor_msgs::Imu::ConstPtr& Imu_)
+    ROS_WARN("Loging to file: %s",realtime_filename.c_str());
+    ROS_WARN("Loging to file: %s",optimized_filename.c_str());
+}
+
+bool Localization::update_anchors(localization::UpdateAnchors::Request& req, localization::UpdateAnchors::Response& res)
 {
-    if (robots.at(self_id).last_header().frame_id.find(Imu_->header.frame_id) == string::npos)
+    res.added = res.moved = res.removed = 0;
+
+    if (req.positions.size() != req.ids.size()*3)
     {
-        robots.at(self_id).append_last_header(Imu_->header.frame_id);
+        res.success = false;
+        res.message = "positions must hold x y z for each id";
+        return true;
+    }
 
-        auto last_vertex = robots.at(self_id).last_vertex(sensor_type.range);
+    std::lock_guard<std::mutex> lock(core_mutex);
 
-        Eigen::Isometry3d current_pose = Eigen::Isometry3d::Identity();
+    // validate the whole set first, so that it is applied completely or not at all
+    for (auto id : req.ids)
+        if (robots.count(id) && !robots.at(id).is_static())
+        {
+            res.success = false;
+            res.message = "robot ID " + std::to_string(id) + " is moving, only anchors can be updated";
+            return true;
+        }
 
-        current_pose.rotate(Quaterniond(Imu_->orientation.w, Imu_->orientation.x, Imu_->orientation.y, Imu_->orientation.z));
+    if (req.replace)
+    {
+        std::set<uint32_t> listed(req.ids.begin(), req.ids.end());
 
-        current_pose.translation() = last_vertex->estimate().translation();
+        for (auto robot = robots.begin(); robot != robots.end();)
+            if (robot->second.is_static() && listed.count(robot->first) == 0)
+            {
+                robot->second.clear(optimizer);
 
-        last_vertex->setEstimate(current_pose);
+                size_t i = std::find(nodesId.begin(), nodesId.end(), (int)robot->first) - nodesId.begin();
 
-        Eigen::MatrixXd  information = Eigen::MatrixXd::Zero(6,6);
-        information(3,3)= 1.0/Imu_->orientation_covariance[0];
-        information(4,4)= 1.0/Imu_->orientation_covariance[4];
-        information(5,5)= 1.0/Imu_->orientation_covariance[8];// roll, pitch, yaw
-        
-        g2o::EdgeSE3Prior* edgeprior = new g2o::EdgeSE3Prior();
-        edgeprior->setInformation(information);
-        edgeprior->vertices()[0]= last_vertex; 
-        edgeprior->setMeasurement(current_pose); 
-        edgeprior->setParameterId(0,0);
-        optimizer.addEdge(edgeprior);
+                if (i < nodesId.size())
+                {
+                    nodesId.erase(nodesId.begin() + i);
+                    nodesPos.erase(nodesPos.begin() + i*3, nodesPos.begin() + i*3 + 3);
+                }
+
+                ROS_WARN("Removed anchor ID: %d", robot->first);
+
+                robot = robots.erase(robot);
 
-        ROS_INFO("added IMU edge id: %d", Imu_->header.seq);
+                ++res.removed;
+            }
+            else
+                ++robot;
     }
 
-    if (publish_imu)
-    {   
-        solve();
-        publish();
+    for (size_t i = 0; i < req.ids.size(); ++i)
+    {
+        Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+        pose(0,3) = req.positions[i*3];
+        pose(1,3) = req.positions[i*3+1];
+        pose(2,3) = req.positions[i*3+2];
+
+        if (robots.count(req.ids[i]))
+        {
+            auto vertex = robots.at(req.ids[i]).last_vertex();
+
+            if (vertex->estimate().translation() == pose.translation())
+                continue;
+
+            vertex->setEstimate(pose);
+
+            size_t index = std::find(nodesId.begin(), nodesId.end(), (int)req.ids[i]) - nodesId.begin();
+
+            if (index < nodesId.size())
+                std::copy(req.positions.begin() + i*3, req.positions.begin() + i*3 + 3, nodesPos.begin() + index*3);
+
+            // residuals of the ranges to the moved anchor schedule the next solve
+            for (auto edge : vertex->edges())
+            {
+                auto e = static_cast<g2o::OptimizableGraph::Edge*>(edge);
+
+                e->computeError();
+
+                pending_impact += e->chi2();
+            }
+
+            ++res.moved;
+        }
+        else
+        {
+            robots.emplace(req.ids[i], Robot(req.ids[i], true, 1));
+
+            robots.at(req.ids[i]).init(optimizer, vertex_ids, pose);
+
+            // the self robot stays last in nodesId
+            nodesId.insert(nodesId.end() - 1, req.ids[i]);
+            nodesPos.insert(nodesPos.end() - 3, req.positions.begin() + i*3, req.positions.begin() + i*3 + 3);
+
+            ++res.added;
+        }
+
+        ROS_WARN("Set anchor ID: %d with position (%.2f,%.2f,%.2f)", req.ids[i], pose(0,3), pose(1,3), pose(2,3));
     }
-}
 
+    build_anchor_index();
 
+    range_gate.clear(); // bursts were judged against the old positions
 
-void Localization::configCallback(localization::localizationConfig &config, uint32_t level)
+    res.success = true;
+
+    res.message = "anchors updated";
+
+    return true;
+}
+
+
+void Localization::build_anchor_index()
 {
-    ROS_WARN("Get publish_optimized_poses: %s", config.publish_optimized_poses? "ture":"false");
+    std::vector<uint32_t> ids;
 
-    if (config.publish_optimized_poses)
-    {
-        ROS_WARN("Publishing Optimized poses");
+    std::vector<Eigen::Vector3d> positions;
 
-        auto path = robots.at(self_id).vertices2path();
-        
-        for (int i = trajectory_length/2; i < trajectory_length; ++i)
+    for (auto& robot : robots)
+        if (robot.second.is_static())
         {
-            pose_optimized_pub.publish(path->poses[i]);
+            ids.push_back(robot.first);
 
-            usleep(10000);
+            positions.push_back(robot.second.last_vertex()->estimate().translation());
         }
-        ROS_WARN("Published. Done");
-    }
+
+    anchor_index.build(ids, positions);
 }
 
 
-inline Eigen::Isometry3d Localization::twist2transform(geometry_msgs::TwistWithCovariance& twist, Eigen::MatrixXd& covariance, double dt)
+void Localization::flush_reorder(const ros::TimerEvent&)
 {
-    tf::Vector3 translation, euler;
+    double now = ros::Time::now().toSec();
+
+    dispatch([this, now]{reorder_buffer.flush(now);});
+}
+
 
-    tf::vector3MsgToTF(twist.twist.linear, translation);
+void Localization::checkpoint_callback(const ros::TimerEvent&)
+{
+    std::lock_guard<std::mutex> lock(core_mutex);
 
-    tf::vector3MsgToTF(twist.twist.angular, euler);
+    save_checkpoint();
+}
 
-    tf::Quaternion quaternion;
 
-    quaternion.setRPY(euler[0]*dt, euler[1]*dt, euler[2]*dt);
+bool Localization::save_checkpoint()
+{
+    string temporary = checkpoint_filename + ".tmp";
 
-    tf::Transform transform(quaternion, translation * dt);
+    ofstream out(temporary.c_str(), ios::binary|ios::trunc);
 
-    Eigen::Isometry3d measurement;
+    uint32_t version = 2, count = 0;
 
-    tf::transformTFToEigen(transform, measurement);
+    ros::Time now = ros::Time::now();
 
-    Eigen::Map<Eigen::MatrixXd> cov(twist.covariance.data(), 6, 6);
+    for (auto& robot : robots)
+        if (!robot.second.is_static())
+            ++count;
 
-    covariance = cov*dt*dt;
+    out.write("UWBCKPT1", 8);
+    out.write((const char*)&version, sizeof(version));
+    out.write((const char*)&now.sec, sizeof(now.sec));
+    out.write((const char*)&now.nsec, sizeof(now.nsec));
+    out.write((const char*)&count, sizeof(count));
 
-    return measurement;
+    for (auto& robot : robots)
+        if (!robot.second.is_static())
+        {
+            out.write((const char*)&robot.first, sizeof(robot.first));
+
+            robot.second.save(out);
+        }
+
+    out.close();
+
+    // replace the previous checkpoint only once the new one is complete
+    if (!out || rename(temporary.c_str(), checkpoint_filename.c_str()) != 0)
+    {
+        ROS_ERROR("Failed to save checkpoint: %s", checkpoint_filename.c_str());
+        return false;
+    }
+
+    return true;
 }
 
 
-inline g2o::EdgeSE3* Localization::create_se3_edge_from_twist(g2o::VertexSE3* vetex1, g2o::VertexSE3* vetex2, geometry_msgs::TwistWithCovariance& twist, double dt)
+bool Localization::restore_checkpoint()
 {
-    g2o::EdgeSE3 *edge = new g2o::EdgeSE3();
+    ifstream in(checkpoint_filename.c_str(), ios::binary);
 
-    edge->vertices()[0] = vetex1;
+    char magic[8];
 
-    edge->vertices()[1] = vetex2;
+    uint32_t version, count;
 
-    Eigen::MatrixXd covariance;
+    ros::Time saved;
 
-    auto measurement = twist2transform(twist, covariance, dt);
+    if (!in.read(magic, 8) || strncmp(magic, "UWBCKPT1", 8) != 0
+        || !in.read((char*)&version, sizeof(version)) || version != 2
+        || !in.read((char*)&saved.sec, sizeof(saved.sec)) || !in.read((char*)&saved.nsec, sizeof(saved.nsec))
+        || !in.read((char*)&count, sizeof(count)))
+    {
+        ROS_WARN("No valid checkpoint in: %s", checkpoint_filename.c_str());
+        return false;
+    }
 
-    edge->setMeasurement(measurement);
+    double age = (ros::Time::now() - saved).toSec();
 
-    edge->setInformation(covariance.inverse());
+    if (age < 0 || age > checkpoint_maximum_age)
+    {
+        ROS_WARN("Checkpoint is %.1fs old, start from the initial positions", age);
+        return false;
+    }
 
-    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t id;
 
-    return edge;
+        if (!in.read((char*)&id, sizeof(id)) || robots.count(id) == 0 || robots.at(id).is_static())
+        {
+            ROS_ERROR("Checkpoint doesn't match the robots, the rest of it is ignored");
+            return false;
+        }
+
+        if (!robots.at(id).restore(in, optimizer))
+        {
+            ROS_ERROR("Checkpoint of robot ID: %d is corrupted, the rest of it is ignored", id);
+            return false;
+        }
+
+        // the restored window has no edges, hold its newest pose loosely until new measurements arrive
+        add_prior(robots.at(id).last_vertex(), checkpoint_sigma_translation, checkpoint_sigma_rotation);
+
+        ROS_WARN("Restored robot ID: %d with %zu vertices from checkpoint", id, robots.at(id).size());
+    }
+
+    // the window is already converged, enable publishing at once, but widen the outlier gate by the
+    // distance moved since the checkpoint until the first full solve has pulled the window onto new ranges
+    number_measurements = trajectory_length + 1;
+
+    outlier_margin = robot_max_velocity * age;
+
+    return true;
 }
 
 
-inline g2o::EdgeSE3Range* Localization::create_range_edge(g2o::VertexSE3* vertex1, g2o::VertexSE3* vertex2, double distance, double covariance)
+void Localization::publish_diagnostics(const ros::TimerEvent&)
 {
-    auto edge = new g2o::EdgeSE3Range();
+    std::lock_guard<std::mutex> lock(core_mutex);
 
-    edge->vertices()[0] = vertex1;
+    diagnostic_msgs::DiagnosticStatus status;
 
-    edge->vertices()[1] = vertex2;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
 
-    edge->setMeasurement(distance);
+    status.name = ros::this_node::getName() + ": latency";
 
-    Eigen::MatrixXd covariance_matrix = Eigen::MatrixXd::Zero(1, 1);
+    status.message = "p50/p99/max in ms";
 
-    covariance_matrix(0,0) = covariance;
+    for (int i = 0; i < Metrics::stages; ++i)
+    {
+        auto stage = Metrics::Stage(i);
 
-    edge->setInformation(covariance_matrix.inverse());
+        diagnostic_msgs::KeyValue value;
 
-    edge->setRobustKernel(new g2o::RobustKernelCauchy());
+        value.key = Metrics::name(stage);
 
-    return edge;
+        std::ostringstream stream;
+
+        stream << std::fixed << std::setprecision(3)
+               << metrics.percentile(stage, 0.5)*1e3 << "/"
+               << metrics.percentile(stage, 0.99)*1e3 << "/"
+               << metrics.maximum(stage)*1e3;
+
+        value.value = stream.str();
+
+        status.values.push_back(value);
+    }
+
+    for (int i = 0; i < Metrics::counters; ++i)
+    {
+        diagnostic_msgs::KeyValue value;
+
+        value.key = Metrics::name(Metrics::Counter(i));
+
+        value.value = std::to_string(metrics.counter(Metrics::Counter(i)));
+
+        status.values.push_back(value);
+    }
+
+    if (threaded)
+    {
+        diagnostic_msgs::KeyValue value;
+
+        value.key = "dropped_tasks";
+
+        value.value = std::to_string(dropped_tasks);
+
+        status.values.push_back(value);
+    }
+
+    if (reorder_buffer.enabled())
+    {
+        diagnostic_msgs::KeyValue value;
+
+        value.key = "reorder_buffered";
+
+        value.value = std::to_string(reorder_buffer.size());
+
+        status.values.push_back(value);
+
+        value.key = "reorder_late";
+
+        value.value = std::to_string(reorder_buffer.late());
+
+        status.values.push_back(value);
+    }
+
+    diagnostic_msgs::DiagnosticArray diagnostics;
+
+    diagnostics.header.stamp = ros::Time::now();
+
+    diagnostics.status.push_back(status);
+
+    diagnostics_pub.publish(diagnostics);
 }
 
 
-inline void Localization::save_file(geometry_msgs::PoseStamped pose, string filename)
+bool Localization::dump_metrics(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 {
-    file.open(filename.c_str(), ios::app);
-    file<<boost::format("%.9f") % (pose.header.stamp.toSec())<<" "
-        <<pose.pose.position.x<<" "
-        <<pose.pose.position.y<<" "
-        <<pose.pose.position.z<<" "
-        <<pose.pose.orientation.x<<" "
-        <<pose.pose.orientation.y<<" "
-        <<pose.pose.orientation.z<<" "
-        <<pose.pose.orientation.w<<endl;
-    file.close();
+    std::lock_guard<std::mutex> lock(core_mutex);
+
+    if (metrics_filename.empty())
+        metrics.dump(cout);
+    else
+    {
+        ofstream stream(metrics_filename.c_str());
+
+        metrics.dump(stream);
+
+        ROS_WARN("Metrics dumped to file: %s", metrics_filename.c_str());
+    }
+
+    return true;
 }
 
 
-void Localization::set_file()
+void Localization::poll_trace(const ros::TimerEvent&)
 {
-    flag_save_file = true;
-    char s[30];
-    struct tm tim;
-    time_t now;
-    now = time(NULL);
-    tim = *(localtime(&now));
-    strftime(s,30,"_%Y_%b_%d_%H_%M_%S.txt",&tim);
-    realtime_filename = name_prefix+"_realtime" + string(s);
-    optimized_filename = name_prefix+"_optimized" + string(s);
-
-    file.open(realtime_filename.c_str(), ios::trunc|ios::out);
-    file<<"# "<<"iteration_max:"<<iteration_max<<"\n";
-    file<<"# "<<"trajectory_length:"<<trajectory_length<<"\n";
-    file<<"# "<<"maximum_velocity:"<<robot_max_velocity<<"\n";
-    file.close();
-
-    file.open(optimized_filename.c_str(), ios::trunc|ios::out);
-    file<<"# "<<"iteration_max:"<<iteration_max<<"\n";
-    file<<"# "<<"trajectory_length:"<<trajectory_length<<"\n";
-    file<<"# "<<"maximum_velocity:"<<robot_max_velocity<<"\n";
-    file.close();
+    if (Trace::requested())
+    {
+        std_srvs::Empty::Request request;
 
-    ROS_WARN("Loging to file: %s",realtime_filename.c_str());
-    ROS_WARN("Loging to file: %s",optimized_filename.c_str());
+        std_srvs::Empty::Response response;
+
+        dump_trace(request, response);
+    }
 }
 
-void Localization::set_file(std::vector<double> antennaOffset)
+
+bool Localization::dump_trace(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 {
-    flag_save_file = true;
-    char s[30];
-    struct tm tim;
-    time_t now;
-    now = time(NULL);
-    tim = *(localtime(&now));
-    strftime(s,30,"_%Y_%b_%d_%H_%M_%S.txt",&tim);
-    realtime_filename = name_prefix+"_realtime" + string(s);
-    optimized_filename = name_prefix+"_optimized" + string(s);
-
-    file.open(realtime_filename.c_str(), ios::trunc|ios::out);
-    file<<"# "<<"iteration_max:"<<iteration_max<<"\n";
-    file<<"# "<<"trajectory_length:"<<trajectory_length<<"\n";
-    file<<"# "<<"maximum_velocity:"<<robot_max_velocity<<"\n";
-    file.close();
-
-    file.open(optimized_filename.c_str(), ios::trunc|ios::out);
-    file<<"# "<<"iteration_max:"<<iteration_max<<"\n";
-    file<<"# "<<"trajectory_length:"<<trajectory_length<<"\n";
-    file<<"# "<<"maximum_velocity:"<<robot_max_velocity<<"\n";
-    file.close();
-
-    file.open(optimized_filename.c_str(), ios::trunc|ios::out);
-    file<<"# "<<"antenna offsets: ";
-    for(unsigned int i = 0; i < antennaOffset.size() - 1; i++)
-        file << antennaOffset[i] << ",";
-    file << antennaOffset[antennaOffset.size()-1] << "\n";
-    file.close();
+    if (trace.dump(trace_filename))
+        ROS_WARN("Trace of %zu events dumped to file: %s", trace.size(), trace_filename.c_str());
+    else
+        ROS_ERROR("Failed to dump trace to file: %s", trace_filename.c_str());
 
-    ROS_WARN("Loging to file: %s",realtime_filename.c_str());
-    ROS_WARN("Loging to file: %s",optimized_filename.c_str());
+    return true;
 }
 
+
 Localization::~Localization()
 {
+    // no callback may run or dispatch while the core is torn down, shutdown waits for the running ones
+    pose_sub.shutdown();
+    range_sub.shutdown();
+    range_epoch_sub.shutdown();
+    tdoa_sub.shutdown();
+    twist_sub.shutdown();
+    lidar_sub.shutdown();
+    imu_sub.shutdown();
+    relative_sub.shutdown();
+
+    reorder_timer.stop();
+    antenna_timer.stop();
+    diagnostics_timer.stop();
+    checkpoint_timer.stop();
+    trace_timer.stop();
+
+    metrics_service.shutdown();
+    anchors_service.shutdown();
+    trace_service.shutdown();
+
+    config_server.reset();
+
+    if (worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            running = false;
+        }
+        task_condition.notify_one();
+        worker.join();
+    }
+
+    if (republisher.joinable())
+        republisher.join();
+
+    // no graph insertion, solve or publish while shutting down
+    reorder_buffer.clear();
+
+    std_srvs::Empty::Request request;
+
+    std_srvs::Empty::Response response;
+
+    dump_metrics(request, response);
+
+    if (!checkpoint_filename.empty() && save_checkpoint())
+        cout<<"Checkpoint saved to file: "<<checkpoint_filename<<endl;
+
     if (flag_save_file)
     {
         auto path = robots.at(self_id).vertices2path();
-        for (int i = trajectory_length/2; i < trajectory_length; ++i)
-            save_file(path->poses[i], optimized_filename);
+        for (size_t i = fixed_lag_index(path); i < path->poses.size(); ++i)
+            optimized_logger.log(path->poses[i]);
+        optimized_logger.close();
         cout<<"Results Loged to file: "<<optimized_filename<<endl;
+
+        if (realtime_logger.dropped_poses() + optimized_logger.dropped_poses() > 0)
+            cout<<"Log writer fell behind, dropped poses: "<<realtime_logger.dropped_poses()<<" realtime, "
+                <<optimized_logger.dropped_poses()<<" optimized"<<endl;
     }
 }
@@ -34,6 +34,14 @@
 
 #include <iostream>
 #include <sstream>
+#include <deque>
+#include <unordered_map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <iomanip>
 #include <string.h>
 #include <stdio.h>
 #include <fstream>
@@ -56,6 +64,9 @@
 #include <g2o/types/slam3d/types_slam3d.h>
 #include "types_edge_se3range.h"
 #include "types_edge_se3range_offset.h"
+#include "types_edge_se3range_knot.h"
+#include "types_edge_se3multirange.h"
+#include "types_edge_se3tdoa.h"
 #include <tf/transform_broadcaster.h>
 #include <tf/transform_datatypes.h>
 #include <tf_conversions/tf_eigen.h>
@@ -69,6 +80,10 @@
 #include <sensor_msgs/Imu.h>
 #include <dynamic_reconfigure/server.h>
 #include <localization/localizationConfig.h>
+#include <localization/SolverTelemetry.h>
+#include <localization/UwbRangeEpoch.h>
+#include <localization/UwbTdoa.h>
+#include <localization/UpdateAnchors.h>
 #include <message_filters/subscriber.h>
 #include <std_msgs/Float64.h>
 #ifdef RELATIVE_LOCALIZATION
@@ -76,9 +91,30 @@
 #endif
 #include "lib.h"
 #include "robot.h"
+#include "preintegration.h"
+#include "keyframe.h"
+#include "metrics.h"
+#include "trace.h"
+#include "trajectory_logger.h"
+#include "reorder_buffer.h"
+#include "anchor_index.h"
+#include "range_gate.h"
+#include "marginal.h"
+#include "multilateration.h"
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Empty.h>
 
 using namespace std;
 
+// per-measurement log lines, compiled out without MEASUREMENT_LOG
+#ifdef MEASUREMENT_LOG
+#define MEASUREMENT_INFO(...) ROS_INFO(__VA_ARGS__)
+#define MEASUREMENT_WARN(...) ROS_WARN(__VA_ARGS__)
+#else
+#define MEASUREMENT_INFO(...)
+#define MEASUREMENT_WARN(...)
+#endif
+
 typedef g2o::BlockSolver_6_3 SE3BlockSolver;
 
 typedef g2o::LinearSolverCholmod<SE3BlockSolver::PoseMatrixType> Solver;
@@ -102,10 +138,12 @@ public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    Localization(ros::NodeHandle);
+    Localization(ros::NodeHandle, bool process_signals = true); // false when the process is shared, e.g. by a nodelet manager
 
     ~Localization();
 
+    void subscribe(ros::NodeHandle&); // topics from the topic/ parameters and dynamic reconfigure, shared by the node and the nodelet
+
     void solve();
 
     void publish();
@@ -115,6 +153,10 @@ public:
 #else
     void addRangeEdge(const bitcraze_lps_estimator::UwbRange::ConstPtr&);
 #endif
+    void addRangeEpoch(const localization::UwbRangeEpoch::ConstPtr&);
+
+    void addTdoaEdge(const localization::UwbTdoa::ConstPtr&);
+
     void addPoseEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr&);
 
     void addLidarEdge(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& pose_cov_);
@@ -129,7 +171,53 @@ public:
 
 private:
 
-    Jeffsan::CPPTimer timer;
+    ros::Subscriber pose_sub, range_sub, range_epoch_sub, tdoa_sub, twist_sub, lidar_sub, imu_sub, relative_sub;
+
+    boost::shared_ptr<dynamic_reconfigure::Server<localization::localizationConfig> > config_server;
+
+// for concurrent ingestion and solving
+    typedef boost::function<void()> Task;
+
+    std::mutex core_mutex; // held by the worker for each task, and by timers and services reading the core
+
+    std::mutex task_mutex;
+
+    std::condition_variable task_condition;
+
+    std::deque<Task> tasks;
+
+    size_t task_capacity;
+
+    std::atomic<size_t> dropped_tasks;
+
+    bool running, deferred;
+
+    std::thread worker, republisher;
+
+    const bool threaded; // fixed at construction, callbacks test it instead of the worker, which the destructor joins
+
+    void dispatch(const Task&); // runs on the worker thread if there is one, otherwise right away
+
+    void run_worker();
+
+    bool deferrable();
+
+    template<class M>
+    ros::Subscriber subscribe_dispatched(ros::NodeHandle&, const string&, uint32_t, void (Localization::*)(const boost::shared_ptr<M const>&));
+
+// for time ordering of measurement streams
+    ReorderBuffer reorder_buffer;
+
+    double reorder_latency;
+
+    int reorder_queue_size;
+
+    ros::Timer reorder_timer;
+
+    void flush_reorder(const ros::TimerEvent&);
+
+    template<class M>
+    ros::Subscriber subscribe_ordered(ros::NodeHandle&, const string&, uint32_t, void (Localization::*)(const boost::shared_ptr<M const>&));
 
     ros::Publisher pose_realtime_pub;
 
@@ -137,25 +225,53 @@ private:
 
     ros::Publisher path_optimized_pub;
 
+    ros::Publisher telemetry_pub;
+
+    ros::Publisher pose_covariance_pub;
+
+    double path_rate; // Hz, 0 publishes the path on every publish
+
+    ros::WallTime path_time;
+
+    localization::SolverTelemetry telemetry;
+
 // for robots
     std::vector<int> nodesId;
 
     std::vector<double> nodesPos;
 
-    map<unsigned char, Robot> robots;
+    std::unordered_map<uint32_t, Robot> robots; // node id -> robot, looked up on every measurement
+
+    VertexIdAllocator vertex_ids;
 
-    unsigned char self_id;
+    uint32_t self_id;
 
     double robot_max_velocity;
 
-    g2o::VertexSE3* key_vertex;
+    size_t key_index; // Robot sequence number of the pose key vertex, pointers of removed vertices get reused
+
+    Keyframe keyframe;
+
+    g2o::EdgeSE3* pose_edge; // newest pose edge, folded until the next keyframe
+
+    size_t pose_index;
+
+    Eigen::Isometry3d pose_keyframe;
+
+    ros::Time pose_keyframe_stamp, pose_stamp;
 
     int trajectory_length;
 
+    double knot_interval;
+
+    double window_horizon, fixed_lag;
+
     int number_measurements;
 
     double distance_outlier;
 
+    double outlier_margin; // added to distance_outlier after a checkpoint restore or a relocalization
+
     double minimum_optimize_error;
 
 // for g2o solver
@@ -169,29 +285,216 @@ private:
 
     std::vector<Eigen::Isometry3d> offsets = std::vector<Eigen::Isometry3d>(3, Eigen::Isometry3d::Identity());
 
+// for passive tags tracked from TDoA
+    std::vector<int> tdoa_tags; // moving robots besides the self robot, published on tf as tag_<id>
+
+// for multi-antenna ranging
+    bool flag_multi_range; // ranges of the requester's antennas to one responder in an epoch make one edge and one vertex
+
+    double antenna_window; // s, UwbRange messages of one requester to one responder from distinct antennas within it form an epoch
+
+    std::map<std::pair<uint32_t, uint32_t>, localization::UwbRangeEpoch> antenna_groups; // pending epochs by requester and responder
+
+    ros::Timer antenna_timer;
+
+    void group_antenna_range(const std_msgs::Header&, uint32_t, uint32_t, double, double, int, Metrics::Clock::time_point);
+
+    void flush_antenna_groups(ros::Time, Metrics::Clock::time_point); // epochs started at or before the stamp, oldest first
+
+    void flush_antenna_group(std::pair<uint32_t, uint32_t>, Metrics::Clock::time_point);
+
+    void flush_antenna_timer(const ros::TimerEvent&);
+
     int iteration_max;
 
+    int tail_length, tail_iteration; // tail refinement between full window optimizations
+
+    double full_window_rate;
+
+    ros::WallTime full_window_time;
+
+// for solve scheduling
+    double pending_impact; // chi2 of the measurements added since the last optimization
+
+    double schedule_skip_chi2, schedule_full_chi2, maximum_solve_rate;
+
+    ros::WallTime solve_time;
+
+// for imu preintegration
+    Preintegration imu_preintegration;
+
+    size_t imu_key_index;
+
+    std_msgs::Header imu_header;
+
+    double gyroscope_noise;
+
+// for twist preintegration
+    bool flag_twist_preintegration;
+
+    Preintegration twist_preintegration;
+
+    Eigen::Vector3d twist_linear, twist_angular;
+
+    Preintegration::Matrix6d twist_covariance;
+
+    ros::Time twist_stamp;
+
+// for latency metrics
+    Metrics metrics;
+
+    ros::Publisher diagnostics_pub;
+
+    ros::Timer diagnostics_timer;
+
+    ros::ServiceServer metrics_service;
+
+    string metrics_filename;
+
+    void publish_diagnostics(const ros::TimerEvent&);
+
+    bool dump_metrics(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
+
+// for anchor gating and selection
+    AnchorIndex anchor_index;
+
+    double anchor_radius; // m, ranges to anchors farther from the requester are rejected, 0 disables
+
+    int anchor_nearest; // anchors per epoch, nearest to the requester, 0 uses all within anchor_radius
+
+    std::vector<uint32_t> anchor_selection;
+
+    void build_anchor_index();
+
+// for innovation gating of ranges
+    RangeGate range_gate;
+
+    int gate_window; // newest vertices whose anchor ranges bound the predicted position covariance
+
+    inline bool predicted_covariance(uint32_t, ros::Time, Eigen::Matrix3d&); // false without anchor ranges to bound it
+
+// for the marginal covariance of the newest pose
+    Marginal marginal;
+
+    int covariance_window; // newest vertices eliminated, older ones are held fixed
+
+    bool covariance_valid;
+
+    Marginal::Matrix6d pose_covariance;
+
+    ros::Time covariance_stamp;
+
+    void update_covariance();
+
+// for divergence detection and relocalization
+    struct RecentRange
+    {
+        ros::Time stamp;
+        double distance, distance_err;
+    };
+
+    std::unordered_map<uint32_t, RecentRange> recent_ranges; // newest range between the self robot and each anchor, gated or not
+
+    Multilateration multilateration;
+
+    int recovery_solves; // consecutive diverged solves before relocalization, 0 disables
+
+    double recovery_range_age, recovery_residual; // s, m
+
+    int diverged; // consecutive solves that left the optimization error too large
+
+    bool solved; // a full solve ran since the last divergence check
+
+    double window_error; // chi2 of the whole window at the last full solve
+
+    bool recovering;
+
+    ros::Time divergence_stamp; // first diverged measurement, the time to recover is counted from it
+
+    Eigen::Isometry3d last_good_pose;
+
+    void detect_divergence();
+
+    bool relocalize(ros::Time);
+
+// for anchor map hot reload
+    ros::ServiceServer anchors_service;
+
+    bool update_anchors(localization::UpdateAnchors::Request&, localization::UpdateAnchors::Response&);
+
+// for checkpoint and warm restart
+    string checkpoint_filename;
+
+    double checkpoint_maximum_age, checkpoint_sigma_translation, checkpoint_sigma_rotation;
+
+    ros::Timer checkpoint_timer;
+
+    void checkpoint_callback(const ros::TimerEvent&);
+
+    bool save_checkpoint();
+
+    bool restore_checkpoint();
+
+// for event trace
+    Trace trace;
+
+    ros::Timer trace_timer;
+
+    ros::ServiceServer trace_service;
+
+    string trace_filename;
+
+    void poll_trace(const ros::TimerEvent&);
+
+    bool dump_trace(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
+
 // for debug
     string realtime_filename, optimized_filename, name_prefix, frame_source, frame_target;
 
-    ofstream file;
+    TrajectoryLogger realtime_logger, optimized_logger;
 
-    bool flag_save_file, publish_tf, publish_range, publish_pose, publish_twist, publish_lidar, publish_imu, publish_relative_range;
+    bool flag_binary_log, flag_save_file, publish_tf, publish_range, publish_pose, publish_twist, publish_lidar, publish_imu, publish_relative_range, publish_telemetry, publish_covariance;
 
     tf::TransformBroadcaster br;
 
     tf::Transform transform;
 
+    void solve_tail();
+
+    void optimize(int, bool, Metrics::Clock::time_point);
+
 // for data convertion
-    inline g2o::EdgeSE3* create_se3_edge_from_twist(g2o::VertexSE3*, g2o::VertexSE3*, geometry_msgs::TwistWithCovariance&, double);
+    inline Metrics::Clock::time_point ingest(unsigned char, ros::Time);
+
+    inline void edge_chi2(double&, double&, double&, double&); // range, motion model, relative SE3 and prior chi2 of the active edges
+
+    inline void add_edge(g2o::OptimizableGraph::Edge*);
+
+    inline g2o::EdgeSE3* create_se3_edge_from_preintegration(g2o::VertexSE3*, g2o::VertexSE3*, Preintegration&);
+
+    inline bool add_twist_edge(g2o::VertexSE3*, g2o::VertexSE3*, ros::Time);
+
+    inline void integrate_twist(ros::Time);
+
+    void add_range_epoch(const localization::UwbRangeEpoch&, Metrics::Clock::time_point);
+
+    bool add_range(const std_msgs::Header&, uint32_t, uint32_t, double, double, int);
+
+    bool add_multi_range(const std_msgs::Header&, uint32_t, uint32_t, const std::vector<double>&, const std::vector<double>&, const std::vector<int>&);
+
+    inline bool gate_range(const std_msgs::Header&, uint32_t, uint32_t, double, double); // logs and counts rejections
+
+    inline g2o::EdgeSE3RangeKnot* create_knot_range_edge(uint32_t, uint32_t, ros::Time, double, double); // NULL if too old for the window
+
+    inline bool knots(uint32_t, ros::Time, std::vector<g2o::VertexSE3*>&, double&); // false if the stamp is before the window
 
     inline g2o::EdgeSE3Range* create_range_edge(g2o::VertexSE3*, g2o::VertexSE3*, double, double);
 
-    inline geometry_msgs::Twist pose2twist(geometry_msgs::Pose, geometry_msgs::Pose, double);
+    inline void add_prior(g2o::VertexSE3*, double, double); // on the current estimate, translation and rotation sigma
 
-    inline Eigen::Isometry3d twist2transform(geometry_msgs::TwistWithCovariance&, Eigen::MatrixXd&, double);
+    inline geometry_msgs::Twist pose2twist(geometry_msgs::Pose, geometry_msgs::Pose, double);
 
-    inline void save_file(geometry_msgs::PoseStamped, string);
+    inline size_t fixed_lag_index(nav_msgs::Path*);
 
 public:
     void set_file();
@@ -199,4 +502,40 @@ public:
 
 };
 
+
+template<class M>
+ros::Subscriber Localization::subscribe_dispatched(ros::NodeHandle& n, const string& topic, uint32_t queue_size, void (Localization::*callback)(const boost::shared_ptr<M const>&))
+{
+    if (!threaded)
+        return n.subscribe(topic, queue_size, callback, this);
+
+    // the spinner threads only queue the messages, the worker builds the graph and solves
+    boost::function<void(const boost::shared_ptr<M const>&)> dispatched = [this, callback](const boost::shared_ptr<M const>& message)
+    {
+        dispatch(boost::bind(callback, this, message));
+    };
+
+    return n.subscribe<M>(topic, std::max(queue_size, (uint32_t)reorder_queue_size), dispatched);
+}
+
+
+template<class M>
+ros::Subscriber Localization::subscribe_ordered(ros::NodeHandle& n, const string& topic, uint32_t queue_size, void (Localization::*callback)(const boost::shared_ptr<M const>&))
+{
+    if (!reorder_buffer.enabled())
+        return subscribe_dispatched(n, topic, queue_size, callback);
+
+    // deep queues, the buffer bounds the latency instead of dropping messages
+    boost::function<void(const boost::shared_ptr<M const>&)> buffered = [this, callback](const boost::shared_ptr<M const>& message)
+    {
+        Task handler = boost::bind(callback, this, message);
+
+        double stamp = message->header.stamp.toSec();
+
+        dispatch([this, stamp, handler]{reorder_buffer.push(stamp, handler);});
+    };
+
+    return n.subscribe<M>(topic, std::max(queue_size, (uint32_t)reorder_queue_size), buffered);
+}
+
 #endif
@@ -0,0 +1,225 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "marginal.h"
+#include <set>
+#include <unordered_map>
+
+
+bool Marginal::compute(const std::vector<g2o::VertexSE3*>& trajectory, Matrix6d& covariance)
+{
+    if (trajectory.empty())
+        return false;
+
+    std::unordered_map<g2o::HyperGraph::Vertex*, size_t> index;
+
+    std::set<g2o::HyperGraph::Edge*> edges;
+
+    for (size_t i = 0; i < trajectory.size(); ++i)
+    {
+        index[trajectory[i]] = i;
+
+        edges.insert(trajectory[i]->edges().begin(), trajectory[i]->edges().end());
+    }
+
+    blocks.assign(trajectory.size(), std::map<size_t, Matrix6d>());
+
+    for (size_t i = 0; i < trajectory.size(); ++i)
+        block(i, i) = Matrix6d::Identity() * prior;
+
+    std::vector<size_t> members;
+
+    std::vector<Jacobian> jacobians;
+
+    for (auto e : edges)
+    {
+        auto edge = static_cast<g2o::OptimizableGraph::Edge*>(e);
+
+        if (edge->level() != 0)
+            continue;
+
+        members.clear();
+
+        jacobians.clear();
+
+        Eigen::MatrixXd information;
+
+        auto range = dynamic_cast<g2o::EdgeSE3Range*>(edge);
+
+        if (range != NULL && range->measurement() == 0)
+        {
+            // a zero range is the motion model, (distance)^2 is quadratic in the translations, so its information is isotropic
+            information = Eigen::MatrixXd::Identity(3, 3) * range->information()(0,0);
+
+            for (int i = 0; i < 2; ++i)
+            {
+                auto member = index.find(range->vertices()[i]);
+
+                if (member == index.end())
+                    continue;
+
+                Jacobian jacobian = Jacobian::Zero(3, 6);
+
+                jacobian.leftCols<3>() = trajectory[member->second]->estimate().rotation() * (i == 0 ? 1 : -1);
+
+                members.push_back(member->second);
+
+                jacobians.push_back(jacobian);
+            }
+        }
+        else
+        {
+            for (auto v : edge->vertices())
+            {
+                auto member = index.find(v);
+
+                if (member == index.end())
+                    continue;
+
+                members.push_back(member->second);
+
+                jacobians.push_back(Jacobian());
+
+                linearize(edge, trajectory[member->second], jacobians.back());
+            }
+
+            information = Eigen::Map<const Eigen::MatrixXd>(edge->informationData(), edge->dimension(), edge->dimension());
+
+            if (edge->robustKernel() != NULL)
+            {
+                Eigen::Vector3d rho;
+
+                edge->robustKernel()->robustify(edge->chi2(), rho);
+
+                information *= rho[1];
+            }
+        }
+
+        for (size_t a = 0; a < members.size(); ++a)
+            for (size_t b = 0; b < members.size(); ++b)
+                if (members[a] <= members[b])
+                    block(members[a], members[b]) += jacobians[a].transpose() * information * jacobians[b];
+    }
+
+    // eliminate oldest first, the fill-in stays between neighbours of the eliminated vertex
+    std::vector<std::pair<size_t, Matrix6d> > reduced;
+
+    for (size_t i = 0; i + 1 < trajectory.size(); ++i)
+    {
+        Eigen::LDLT<Matrix6d> pivot(blocks[i].at(i));
+
+        if (pivot.info() != Eigen::Success || !pivot.isPositive())
+            return false;
+
+        reduced.clear();
+
+        for (auto& column : blocks[i])
+            if (column.first > i)
+                reduced.emplace_back(column.first, pivot.solve(column.second));
+
+        for (auto& row : blocks[i])
+            if (row.first > i)
+                for (auto& column : reduced)
+                    if (column.first >= row.first)
+                        block(row.first, column.first) -= row.second.transpose() * column.second;
+
+        blocks[i].clear();
+    }
+
+    Eigen::LDLT<Matrix6d> last(blocks.back().at(trajectory.size()-1));
+
+    if (last.info() != Eigen::Success || !last.isPositive())
+        return false;
+
+    Matrix6d local = last.solve(Matrix6d::Identity());
+
+    // VertexSE3 is perturbed on the right by a translation and a quaternion vector part, i.e. half the rotation angle
+    Matrix6d rotation = Matrix6d::Zero();
+
+    rotation.topLeftCorner<3,3>() = trajectory.back()->estimate().rotation();
+
+    rotation.bottomRightCorner<3,3>() = trajectory.back()->estimate().rotation() * 2;
+
+    covariance = rotation * local * rotation.transpose();
+
+    return true;
+}
+
+
+void Marginal::linearize(g2o::OptimizableGraph::Edge* edge, g2o::VertexSE3* vertex, Jacobian& jacobian)
+{
+    int dimension = edge->dimension();
+
+    jacobian.resize(dimension, 6);
+
+    Eigen::VectorXd plus(dimension);
+
+    double delta[6];
+
+    for (int i = 0; i < 6; ++i)
+    {
+        std::fill(delta, delta + 6, 0.0);
+
+        delta[i] = step;
+
+        vertex->push();
+
+        vertex->oplus(delta);
+
+        edge->computeError();
+
+        plus = Eigen::Map<const Eigen::VectorXd>(edge->errorData(), dimension);
+
+        vertex->pop();
+
+        delta[i] = -step;
+
+        vertex->push();
+
+        vertex->oplus(delta);
+
+        edge->computeError();
+
+        jacobian.col(i) = (plus - Eigen::Map<const Eigen::VectorXd>(edge->errorData(), dimension)) / (2 * step);
+
+        vertex->pop();
+    }
+
+    edge->computeError();
+}
+
+
+Marginal::Matrix6d& Marginal::block(size_t i, size_t j)
+{
+    auto found = blocks[i].find(j);
+
+    if (found == blocks[i].end())
+        found = blocks[i].emplace(j, Matrix6d::Zero()).first;
+
+    return found->second;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MARGINAL_H
+#define MARGINAL_H
+
+#include <vector>
+#include <map>
+#include <Eigen/Dense>
+#include <g2o/core/optimizable_graph.h>
+#include <g2o/types/slam3d/types_slam3d.h>
+#include "types_edge_se3range.h"
+
+// Marginal covariance of the newest vertex of a trajectory, without the sparse inverse of the whole window.
+// The information of the trajectory vertices is linearized at the current estimate, with the other vertices
+// (anchors, older vertices, other robots) held fixed, and the vertices are eliminated oldest first.
+// A trajectory is block-tridiagonal, so each elimination is a few 6x6 products and the cost is linear in its length.
+// Jacobians are numeric, so any edge type contributes, weighted by its robust kernel as in the solver.
+class Marginal
+{
+public:
+
+    typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+    Marginal(double step = 1e-6, double prior = 1e-6):step(step), prior(prior){};
+
+    // trajectory oldest first; covariance of translation (m) and rotation about the world axes (rad), in the world frame
+    bool compute(const std::vector<g2o::VertexSE3*>&, Matrix6d&);
+
+private:
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 6> Jacobian;
+
+    void linearize(g2o::OptimizableGraph::Edge*, g2o::VertexSE3*, Jacobian&);
+
+    Matrix6d& block(size_t, size_t); // zero initialized on first access
+
+    std::vector<std::map<size_t, Matrix6d> > blocks; // upper triangle, row i holds the columns j >= i
+
+    double step; // numeric differentiation step on the minimal parameters
+
+    double prior; // information on every vertex, unobserved directions get the variance 1/prior
+};
+
+#endif
@@ -0,0 +1,126 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.h"
+
+
+Metrics::Metrics()
+{
+    for (int i = 0; i < stages; ++i)
+    {
+        for (int j = 0; j < buckets; ++j)
+            histogram[i][j] = 0;
+
+        total[i] = 0;
+        sum[i] = 0;
+        max[i] = 0;
+    }
+
+    for (int i = 0; i < counters; ++i)
+        counts[i] = 0;
+}
+
+
+void Metrics::record(Stage stage, double seconds)
+{
+    if (seconds < 0)
+        seconds = 0;
+
+    int bucket = seconds > 1e-6 ? (int)ceil(8 * log2(seconds / 1e-6)) : 0;
+
+    if (bucket >= buckets)
+        bucket = buckets - 1;
+
+    ++histogram[stage][bucket];
+
+    ++total[stage];
+
+    sum[stage] += seconds;
+
+    if (seconds > max[stage])
+        max[stage] = seconds;
+}
+
+
+double Metrics::percentile(Stage stage, double ratio) const
+{
+    if (total[stage] == 0)
+        return 0;
+
+    unsigned long target = (unsigned long)ceil(ratio * total[stage]), cumulative = 0;
+
+    for (int i = 0; i < buckets; ++i)
+    {
+        cumulative += histogram[stage][i];
+
+        if (cumulative >= target)
+            return std::min(bound(i), max[stage]);
+    }
+
+    return max[stage];
+}
+
+
+double Metrics::bound(int bucket)
+{
+    return 1e-6 * pow(2.0, bucket / 8.0);
+}
+
+
+const char* Metrics::name(Stage stage)
+{
+    static const char* names[] = {"ingest", "graph", "initialize", "optimize", "marginal", "path", "publish", "recovery"};
+    return names[stage];
+}
+
+
+const char* Metrics::name(Counter counter)
+{
+    static const char* names[] = {"measurements", "rejections", "skipped_solves", "skipped_publishes", "relocalizations"};
+    return names[counter];
+}
+
+
+void Metrics::dump(std::ostream& os) const
+{
+    os << "# stage samples mean_ms p50_ms p99_ms max_ms" << std::endl;
+
+    for (int i = 0; i < stages; ++i)
+    {
+        Stage stage = (Stage)i;
+
+        os << std::setw(12) << name(stage) << " " << std::setw(10) << samples(stage) << std::fixed << std::setprecision(3)
+           << " " << mean(stage)*1e3 << " " << percentile(stage, 0.5)*1e3
+           << " " << percentile(stage, 0.99)*1e3 << " " << maximum(stage)*1e3 << std::endl;
+    }
+
+    os << "# counter value" << std::endl;
+
+    for (int i = 0; i < counters; ++i)
+        os << std::setw(18) << name((Counter)i) << " " << counter((Counter)i) << std::endl;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <math.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+// Latency histograms per processing stage and event counters.
+// Buckets are log-spaced (8 per octave from 1us), so recording is a log2 and an increment.
+class Metrics
+{
+public:
+
+    enum Stage {ingest, graph, initialize, optimize, marginal, path, publish, recovery, stages};
+
+    enum Counter {measurements, rejections, skipped_solves, skipped_publishes, relocalizations, counters};
+
+    typedef std::chrono::steady_clock Clock;
+
+    Metrics();
+
+    static Clock::time_point now(){return Clock::now();};
+
+    void record(Stage, double);
+
+    void record(Stage stage, Clock::time_point start)
+    {
+        record(stage, std::chrono::duration<double>(Clock::now() - start).count());
+    };
+
+    void count(Counter counter, unsigned long n = 1){counts[counter] += n;};
+
+    double percentile(Stage, double) const;
+
+    double maximum(Stage stage) const {return max[stage];};
+
+    double mean(Stage stage) const {return total[stage] ? sum[stage]/total[stage] : 0;};
+
+    unsigned long samples(Stage stage) const {return total[stage];};
+
+    unsigned long counter(Counter counter) const {return counts[counter];};
+
+    static const char* name(Stage);
+
+    static const char* name(Counter);
+
+    void dump(std::ostream&) const;
+
+private:
+
+    static const int buckets = 192;
+
+    static double bound(int); // upper bound of a bucket in seconds
+
+    unsigned long histogram[stages][buckets];
+
+    unsigned long total[stages];
+
+    double sum[stages], max[stages];
+
+    unsigned long counts[counters];
+};
+
+#endif
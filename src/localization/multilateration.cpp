@@ -0,0 +1,122 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "multilateration.h"
+
+
+bool Multilateration::solve(Eigen::Vector3d& position, double& rms)
+{
+    if (anchors.size() < 3)
+        return false;
+
+    // least squares first to get near the fix, then the kernel to discount the outliers
+    for (int iteration = 0; iteration < 2 * iterations; ++iteration)
+    {
+        bool robust = iteration >= iterations;
+
+        Eigen::Matrix3d hessian = Eigen::Matrix3d::Identity() * 1e-3;
+
+        Eigen::Vector3d gradient = Eigen::Vector3d::Zero();
+
+        for (size_t i = 0; i < anchors.size(); ++i)
+        {
+            Eigen::Vector3d direction = position - anchors[i];
+
+            double norm = direction.norm();
+
+            if (norm < 1e-6)
+                continue;
+
+            direction /= norm;
+
+            double residual = (distances[i] - norm) / sigmas[i];
+
+            double weight = (robust ? 1.0 / (1.0 + pow(residual / kernel, 2)) : 1.0) / pow(sigmas[i], 2);
+
+            hessian += weight * direction * direction.transpose();
+
+            gradient += weight * direction * (distances[i] - norm);
+        }
+
+        Eigen::Vector3d step = hessian.ldlt().solve(gradient);
+
+        // halve the step while it increases the cost, far from the fix the ranges are strongly nonlinear
+        double current = cost(position, robust);
+
+        for (int i = 0; i < 10 && cost(position + step, robust) > current; ++i)
+            step /= 2;
+
+        position += step;
+
+        if (step.norm() < 1e-4)
+        {
+            if (robust)
+                break;
+
+            iteration = iterations - 1;
+        }
+    }
+
+    double sum = 0;
+
+    size_t inliers = 0;
+
+    for (size_t i = 0; i < anchors.size(); ++i)
+    {
+        double residual = distances[i] - (position - anchors[i]).norm();
+
+        if (fabs(residual) < kernel * sigmas[i] * 3)
+        {
+            sum += residual * residual;
+            ++inliers;
+        }
+    }
+
+    // a fix explaining only a minority of the ranges is as likely a mirror or an outlier fit
+    if (inliers < 3 || 2 * inliers <= anchors.size())
+        return false;
+
+    rms = sqrt(sum / inliers);
+
+    return std::isfinite(rms);
+}
+
+
+double Multilateration::cost(const Eigen::Vector3d& position, bool robust)
+{
+    double sum = 0;
+
+    for (size_t i = 0; i < anchors.size(); ++i)
+    {
+        double residual = (distances[i] - (position - anchors[i]).norm()) / sigmas[i];
+
+        sum += robust ? pow(kernel, 2) * log(1 + pow(residual / kernel, 2)) : residual * residual;
+    }
+
+    return sum;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MULTILATERATION_H
+#define MULTILATERATION_H
+
+#include <math.h>
+#include <vector>
+#include <Eigen/Dense>
+
+// Position fix from ranges to known anchors, independent of the graph.
+// Gauss-Newton from an initial guess, with a Cauchy kernel so that a few NLOS ranges don't drag the fix,
+// and a small damping that keeps unobserved directions (e.g. height under coplanar anchors) at the guess.
+class Multilateration
+{
+public:
+
+    Multilateration(double kernel = 1.0, int iterations = 20):kernel(kernel), iterations(iterations){};
+
+    void clear(){anchors.clear(); distances.clear(); sigmas.clear();};
+
+    void add(const Eigen::Vector3d& anchor, double distance, double sigma)
+    {
+        anchors.push_back(anchor);
+        distances.push_back(distance);
+        sigmas.push_back(sigma);
+    };
+
+    size_t size(){return anchors.size();};
+
+    bool solve(Eigen::Vector3d&, double&); // initial guess in, fix out, and the rms residual (m) of the ranges within the kernel
+
+private:
+
+    double cost(const Eigen::Vector3d&, bool);
+
+    std::vector<Eigen::Vector3d> anchors;
+
+    std::vector<double> distances, sigmas;
+
+    double kernel; // Cauchy kernel width in standard deviations
+
+    int iterations;
+};
+
+#endif
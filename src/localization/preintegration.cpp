@@ -0,0 +1,102 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "preintegration.h"
+
+
+void Preintegration::reset()
+{
+    delta_pose = Eigen::Isometry3d::Identity();
+
+    delta_covariance = Matrix6d::Zero();
+
+    delta_time = 0;
+
+    count = 0;
+}
+
+
+void Preintegration::integrate(const Eigen::Vector3d& linear, const Eigen::Vector3d& angular, const Matrix6d& covariance, double dt)
+{
+    if (dt <= 0)
+        return;
+
+    Eigen::Vector3d rotation = angular * dt;
+
+    double angle = rotation.norm();
+
+    Eigen::Isometry3d increment = Eigen::Isometry3d::Identity();
+
+    if (angle > 1e-12)
+        increment.rotate(Eigen::AngleAxisd(angle, rotation / angle));
+
+    increment.translation() = linear * dt;
+
+    // Z = A * B, so the accumulated error moves into the increment frame through Ad(B^-1)
+    Eigen::Matrix3d R = increment.rotation().transpose();
+
+    Eigen::Vector3d t = -R * increment.translation();
+
+    Eigen::Matrix3d t_skew;
+    t_skew <<     0, -t(2),  t(1),
+               t(2),     0, -t(0),
+              -t(1),  t(0),     0;
+
+    Matrix6d adjoint = Matrix6d::Zero();
+    adjoint.block<3,3>(0,0) = R;
+    adjoint.block<3,3>(0,3) = t_skew * R;
+    adjoint.block<3,3>(3,3) = R;
+
+    delta_covariance = adjoint * delta_covariance * adjoint.transpose() + covariance * dt * dt;
+
+    delta_pose = delta_pose * increment;
+
+    delta_time += dt;
+
+    ++count;
+}
+
+
+Preintegration::Matrix6d Preintegration::information()
+{
+    // quaternion xyz is half of the rotation vector for small angles
+    Matrix6d jacobian = Matrix6d::Identity();
+    jacobian.block<3,3>(3,3) *= 0.5;
+
+    Matrix6d covariance = jacobian * delta_covariance * jacobian.transpose();
+
+    Matrix6d information = Matrix6d::Zero();
+
+    // rotation-only sources (gyroscope) leave the translation unconstrained
+    if (covariance.block<3,3>(0,0).isZero())
+        information.block<3,3>(3,3) = covariance.block<3,3>(3,3).inverse();
+    else
+        information = covariance.inverse();
+
+    return information;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PREINTEGRATION_H
+#define PREINTEGRATION_H
+
+#include <math.h>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+// Accumulates body-frame velocity samples into one relative motion and its covariance.
+// The covariance is kept on the local perturbation [translation, rotation vector].
+class Preintegration
+{
+public:
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+    Preintegration(){reset();};
+
+    void reset();
+
+    void integrate(const Eigen::Vector3d&, const Eigen::Vector3d&, const Matrix6d&, double);
+    // linear and angular velocity held over dt, with the covariance of [linear, angular]
+
+    Eigen::Isometry3d delta(){return delta_pose;};
+
+    Matrix6d covariance(){return delta_covariance;};
+
+    Matrix6d information();
+    // information of the g2o::EdgeSE3 error [translation, quaternion xyz]
+
+    double duration(){return delta_time;};
+
+    int size(){return count;};
+
+private:
+
+    Eigen::Isometry3d delta_pose;
+
+    Matrix6d delta_covariance;
+
+    double delta_time;
+
+    int count;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "range_gate.h"
+
+
+bool RangeGate::accept(uint32_t tag, uint32_t id, double innovation, double variance)
+{
+    int& rejected = rejections[tag];
+
+    if (lockout > 0 && rejected >= lockout)
+    {
+        clear(tag);
+        return true;
+    }
+
+    State& state = states[key(tag, id)];
+
+    bool pass = variance > 0 && innovation * innovation < threshold * variance;
+
+    if (!pass)
+    {
+        ++rejected;
+        ++state.rejected;
+        state.passed = 0;
+
+        if (burst > 0 && state.rejected >= burst)
+            state.burst = true;
+
+        return false;
+    }
+
+    state.rejected = 0;
+
+    if (state.burst && ++state.passed < recovery)
+    {
+        ++rejected;
+        return false;
+    }
+
+    state.burst = false;
+    state.passed = 0;
+
+    rejected = 0;
+
+    return true;
+}
+
+
+bool RangeGate::in_burst(uint32_t tag, uint32_t id)
+{
+    auto state = states.find(key(tag, id));
+
+    return state != states.end() && state->second.burst;
+}
+
+
+int RangeGate::consecutive_rejections(uint32_t tag)
+{
+    auto rejected = rejections.find(tag);
+
+    return rejected == rejections.end() ? 0 : rejected->second;
+}
+
+
+void RangeGate::clear()
+{
+    states.clear();
+
+    rejections.clear();
+}
+
+
+void RangeGate::clear(uint32_t tag)
+{
+    for (auto state = states.begin(); state != states.end();)
+        if (state->first >> 32 == tag)
+            state = states.erase(state);
+        else
+            ++state;
+
+    rejections.erase(tag);
+}
@@ -0,0 +1,81 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef RANGE_GATE_H
+#define RANGE_GATE_H
+
+#include <stdint.h>
+#include <unordered_map>
+
+// Innovation gate for ranges, with NLOS burst tracking per tag and responder.
+// A range passes if innovation^2 / variance is below the chi2 threshold, the variance being the
+// predicted range variance (estimate covariance along the line of sight plus the measurement variance).
+// After burst consecutive rejections a responder is in an NLOS burst for that tag, and its ranges to the tag are
+// rejected until recovery consecutive ones pass again, since the first ranges out of a blockage are often still biased.
+// After lockout consecutive rejections of one tag over all responders its estimate, not the ranges, is suspect:
+// the next range of the tag is accepted and its burst states are cleared. Tags don't share any state.
+class RangeGate
+{
+public:
+
+    RangeGate(double chi2 = 0, int burst = 3, int recovery = 3, int lockout = 20)
+        :threshold(chi2), burst(burst), recovery(recovery), lockout(lockout){};
+
+    bool enabled(){return threshold > 0;};
+
+    bool accept(uint32_t tag, uint32_t id, double innovation, double variance); // updates the burst state of the responder for the tag
+
+    bool in_burst(uint32_t tag, uint32_t id);
+
+    void clear(); // forgets all burst states, e.g. after the anchor map is replaced
+
+    void clear(uint32_t tag); // forgets the burst states of one tag, e.g. after its estimate is reset
+
+    int consecutive_rejections(uint32_t tag);
+
+private:
+
+    struct State
+    {
+        int rejected; // consecutive rejections
+        int passed;   // consecutive passes during a burst
+        bool burst;
+    };
+
+    static uint64_t key(uint32_t tag, uint32_t id){return (uint64_t)tag << 32 | id;};
+
+    std::unordered_map<uint64_t, State> states; // by tag and responder
+
+    double threshold;
+
+    int burst, recovery, lockout;
+
+    std::unordered_map<uint32_t, int> rejections; // consecutive per tag, over all responders
+};
+
+#endif
@@ -0,0 +1,82 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "reorder_buffer.h"
+
+
+void ReorderBuffer::push(double stamp, const Handler& handler)
+{
+    // handling it now would put it behind newer measurements of the same robot
+    if (stamp < released)
+    {
+        ++late_count;
+        return;
+    }
+
+    queue.push(Entry{stamp, sequence++, handler});
+
+    if (stamp > newest)
+        newest = stamp;
+
+    release(newest - latency);
+
+    while (queue.size() > capacity)
+        pop();
+}
+
+
+void ReorderBuffer::flush(double now)
+{
+    release(now - latency);
+}
+
+
+void ReorderBuffer::clear()
+{
+    while (!queue.empty())
+        queue.pop();
+}
+
+
+void ReorderBuffer::release(double until)
+{
+    while (!queue.empty() && queue.top().stamp <= until)
+        pop();
+}
+
+
+void ReorderBuffer::pop()
+{
+    Entry entry = queue.top();
+
+    queue.pop();
+
+    released = entry.stamp;
+
+    entry.handler();
+}
@@ -0,0 +1,93 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef REORDER_BUFFER_H
+#define REORDER_BUFFER_H
+
+#include <stdint.h>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <boost/function.hpp>
+
+// Time-ordered buffer that merges measurement streams before graph insertion.
+// A measurement is held until the newest stamp seen is latency seconds past it, or the buffer exceeds its capacity,
+// so messages arriving up to latency late are still inserted in stamp order.
+// Later ones can't be ordered any more, they are dropped and counted by late().
+class ReorderBuffer
+{
+public:
+
+    typedef boost::function<void()> Handler;
+
+    ReorderBuffer(double latency = 0, size_t capacity = 1000):latency(latency), capacity(capacity), sequence(0), newest(0), released(0), late_count(0){};
+
+    bool enabled(){return latency > 0;};
+
+    void push(double stamp, const Handler&); // runs the handlers released by the new stamp, drops it if already passed
+
+    void flush(double now); // releases what is older than now - latency, when the streams pause
+
+    void clear(); // drops all buffered handlers without running them
+
+    size_t size(){return queue.size();};
+
+    size_t late(){return late_count;};
+
+private:
+
+    struct Entry
+    {
+        double stamp;
+        uint64_t sequence; // keeps arrival order for equal stamps
+        Handler handler;
+
+        bool operator>(const Entry& other) const
+        {
+            return stamp > other.stamp || (stamp == other.stamp && sequence > other.sequence);
+        };
+    };
+
+    void release(double until);
+
+    void pop();
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+
+    double latency;
+
+    size_t capacity;
+
+    uint64_t sequence;
+
+    double newest, released; // newest stamp pushed, newest stamp handled
+
+    size_t late_count;
+};
+
+#endif
@@ -28,58 +28,94 @@
 
 #include "robot.h"
 
-void Robot::init(g2o::SparseOptimizer& optimizer, Eigen::Isometry3d vertex_init)
+
+static void write_header(std::ostream& out, const std_msgs::Header& header)
+{
+    uint32_t data[4] = {header.seq, header.stamp.sec, header.stamp.nsec, (uint32_t)header.frame_id.size()};
+
+    out.write((const char*)data, sizeof(data));
+
+    out.write(header.frame_id.data(), header.frame_id.size());
+}
+
+
+static bool read_header(std::istream& in, std_msgs::Header& header)
+{
+    uint32_t data[4];
+
+    if (!in.read((char*)data, sizeof(data)) || data[3] > 1024)
+        return false;
+
+    header.seq = data[0];
+    header.stamp.sec = data[1];
+    header.stamp.nsec = data[2];
+    header.frame_id.resize(data[3]);
+
+    return (bool)in.read(&header.frame_id[0], data[3]);
+}
+
+void Robot::init(g2o::SparseOptimizer& optimizer, VertexIdAllocator& allocator, Eigen::Isometry3d vertex_init)
 {
     index = 0;
     path = new nav_msgs::Path();
+    path_changed = 1;
+    path_removed = 0;
 
-    path->poses = vector<geometry_msgs::PoseStamped>(trajectory_length, geometry_msgs::PoseStamped());
-    header = std::vector<std_msgs::Header>(trajectory_length, std_msgs::Header());
+    this->allocator = &allocator;
 
-    for (int i = 0; i < trajectory_length; ++i)
-    {
-        g2o::VertexSE3* vertex = new g2o::VertexSE3();
+    g2o::VertexSE3* vertex = new g2o::VertexSE3();
 
-        vertex->setId(ID + i*300);
+    vertex->setId(allocator.allocate());
 
-        vertex->setEstimate(vertex_init);
+    vertex->setEstimate(vertex_init);
 
-        vertices.push_back(vertex);
+    if(FLAG_STATIC)
+        vertex->setFixed(true);
 
-        geometry_msgs::PoseStamped pose;
+    optimizer.addVertex(vertex);
 
-        if(FLAG_STATIC)
-            vertex->setFixed(true);
+    vertices.push_back(vertex);
 
-        optimizer.addVertex(vertex);
-    }
+    header.push_back(std_msgs::Header());
 
-    header[0].frame_id = "none";
+    header.back().frame_id = "none";
 }
 
 
 nav_msgs::Path* Robot::vertices2path()
 {
-    for (int i = 0; i < trajectory_length; ++i)
+    auto& poses = path->poses;
+
+    poses.erase(poses.begin(), poses.begin() + std::min(path_removed, poses.size()));
+
+    size_t converted = std::min(poses.size(), vertices.size() - std::min(path_changed, vertices.size()));
+
+    poses.resize(vertices.size());
+
+    for (size_t i = converted; i < vertices.size(); ++i)
     {
-        int idx = (index+1+i)%trajectory_length;
-        tf::poseEigenToMsg(vertices[idx]->estimate(), path->poses[i].pose);
-        path->poses[i].header = header[idx];
+        tf::poseEigenToMsg(vertices[i]->estimate(), poses[i].pose);
+        poses[i].header = header[i];
     }
     path->header = last_header();
 
+    // the newest vertex and its header are also updated outside of solves
+    path_changed = 1;
+
+    path_removed = 0;
+
     return path;
 }
 
 
-g2o::VertexSE3* Robot::new_vertex(unsigned char type, std_msgs::Header new_header, g2o::SparseOptimizer& optimizer)
+g2o::VertexSE3* Robot::new_vertex(unsigned char type, const std_msgs::Header& new_header, g2o::SparseOptimizer& optimizer)
 {
     type_index.emplace(type, index);
     headers.emplace(type, new_header);
 
     if(FLAG_STATIC)
     {
-        header[index] = new_header;
+        header.back() = new_header;
         return last_vertex(type);
     }
     
@@ -87,17 +123,18 @@ g2o::VertexSE3* Robot::new_vertex(unsigned char type, std_msgs::Header new_heade
     {   
         auto vertex = new g2o::VertexSE3();
 
-        vertex->setEstimate(vertices[index]->estimate());
+        vertex->setEstimate(vertices.back()->estimate());
 
-        index = (index+1)%trajectory_length;
+        if (vertices.size() >= (size_t)trajectory_length)
+            remove_oldest(optimizer);
 
-        vertex->setId(index*300 + ID);
+        ++index;
 
-        optimizer.removeVertex(vertices[index], false);
+        vertex->setId(allocator->allocate());
 
-        vertices[index] = vertex;
+        vertices.push_back(vertex);
 
-        header[index] = new_header;
+        header.push_back(new_header);
 
         type_index.at(type) = index;
 
@@ -105,41 +142,146 @@ g2o::VertexSE3* Robot::new_vertex(unsigned char type, std_msgs::Header new_heade
 
         optimizer.addVertex(vertex);
 
+        // shrink the window to the time horizon, keeping at least two vertices
+        if (window_horizon > 0)
+            while (vertices.size() > 2 && (new_header.stamp - header.front().stamp).toSec() > window_horizon)
+                remove_oldest(optimizer);
+
         return vertex;
     }
 }
 
 
+void Robot::remove_oldest(g2o::SparseOptimizer& optimizer)
+{
+    allocator->release(vertices.front()->id());
+
+    optimizer.removeVertex(vertices.front(), false);
+
+    vertices.pop_front();
+
+    header.pop_front();
+
+    ++path_removed;
+}
+
+
 g2o::VertexSE3* Robot::last_vertex(unsigned char type)
+{
+    return vertex_at(last_index(type));
+}
+
+
+size_t Robot::last_index(unsigned char type)
 {
     type_index.emplace(type, index);
-    headers.emplace(type, header[index]);
-    return vertices.at(type_index[type]);
+    headers.emplace(type, header.back());
+
+    // the oldest vertex stands in for one that left the window
+    return std::max(type_index[type], index + 1 - vertices.size());
+}
+
+
+g2o::VertexSE3* Robot::vertex_at(size_t sequence)
+{
+    size_t oldest = index + 1 - vertices.size();
+
+    if (sequence < oldest || sequence > index)
+        return NULL;
+
+    return vertices[sequence - oldest];
 }
 
 
 g2o::VertexSE3* Robot::last_vertex()
 {
-    return vertices.at(index);
+    return vertices.back();
+}
+
+
+g2o::VertexSE3* Robot::previous_vertex()
+{
+    return vertices.size() > 1 ? vertices[vertices.size()-2] : vertices.front();
+}
+
+
+void Robot::tail(size_t length, g2o::HyperGraph::VertexSet& tail_vertices)
+{
+    for (size_t i = vertices.size() > length ? vertices.size() - length : 0; i < vertices.size(); ++i)
+        tail_vertices.insert(vertices[i]);
+}
+
+
+void Robot::tail(size_t length, std::vector<g2o::VertexSE3*>& tail_vertices)
+{
+    tail_vertices.assign(vertices.end() - std::min(length, vertices.size()), vertices.end());
 }
 
 
 std_msgs::Header Robot::last_header(unsigned char type)
 {
-    headers.emplace(type, header[index]);
+    headers.emplace(type, header.back());
     return headers.at(type);
 }
 
 
 std_msgs::Header Robot::last_header()
 {
-    return header[index];
+    return header.back();
+}
+
+
+std_msgs::Header Robot::previous_header()
+{
+    return header.size() > 1 ? header[header.size()-2] : header.front();
+}
+
+
+double Robot::span()
+{
+    for (auto& h : header)
+        if (!h.stamp.isZero())
+            return (header.back().stamp - h.stamp).toSec();
+
+    return 0;
+}
+
+
+double Robot::bracket(ros::Time stamp, g2o::VertexSE3*& before, g2o::VertexSE3*& after)
+{
+    if (stamp < header.front().stamp)
+        return -1;
+
+    size_t i = vertices.size() - 1;
+
+    // measurements are mostly recent, so search from the newest vertex
+    while (i > 1 && header[i-1].stamp > stamp)
+        --i;
+
+    before = vertices[i > 0 ? i-1 : 0];
+
+    after = vertices[i];
+
+    double span = (header[i].stamp - header[i > 0 ? i-1 : 0].stamp).toSec();
+
+    if (span <= 0)
+        return 1;
+
+    return std::min(1.0, std::max(0.0, (stamp - header[i-1].stamp).toSec() / span));
 }
 
 
 void Robot::append_last_header(string frame_id)
 {
-    header[index].frame_id += ("-"+frame_id);
+    header.back().frame_id += ("-"+frame_id);
+}
+
+
+void Robot::update_last_header(unsigned char type, const std_msgs::Header& new_header)
+{
+    header.back() = new_header;
+
+    headers[type] = new_header;
 }
 
 
@@ -155,3 +297,162 @@ geometry_msgs::PoseStamped Robot::current_pose()
 
     return pose;
 }
+
+
+void Robot::save(std::ostream& out)
+{
+    uint32_t count = vertices.size();
+
+    out.write((const char*)&count, sizeof(count));
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        write_header(out, header[i]);
+
+        Eigen::Quaterniond q(vertices[i]->estimate().rotation());
+
+        Eigen::Vector3d t = vertices[i]->estimate().translation();
+
+        double pose[7] = {t.x(), t.y(), t.z(), q.x(), q.y(), q.z(), q.w()};
+
+        out.write((const char*)pose, sizeof(pose));
+    }
+
+    uint32_t types = type_index.size();
+
+    out.write((const char*)&types, sizeof(types));
+
+    for (auto& type : type_index)
+    {
+        uint32_t age = index - type.second; // vertices since the newest of this type
+
+        out.write((const char*)&type.first, sizeof(type.first));
+
+        out.write((const char*)&age, sizeof(age));
+
+        write_header(out, headers.at(type.first));
+    }
+}
+
+
+bool Robot::restore(std::istream& in, g2o::SparseOptimizer& optimizer)
+{
+    uint32_t count, types;
+
+    if (!in.read((char*)&count, sizeof(count)) || count == 0 || count > (uint32_t)trajectory_length)
+        return false;
+
+    std::vector<std_msgs::Header> new_header(count);
+
+    std::vector<Eigen::Isometry3d> poses(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        double pose[7];
+
+        if (!read_header(in, new_header[i]) || !in.read((char*)pose, sizeof(pose)))
+            return false;
+
+        poses[i] = Eigen::Isometry3d(Eigen::Quaterniond(pose[6], pose[3], pose[4], pose[5]).normalized());
+
+        poses[i].translation() = Eigen::Vector3d(pose[0], pose[1], pose[2]);
+    }
+
+    map<unsigned char, size_t> new_type_index;
+
+    map<unsigned char, std_msgs::Header> new_headers;
+
+    if (!in.read((char*)&types, sizeof(types)))
+        return false;
+
+    for (size_t i = 0; i < types; ++i)
+    {
+        unsigned char type;
+
+        uint32_t age;
+
+        std_msgs::Header type_header;
+
+        if (!in.read((char*)&type, sizeof(type)) || !in.read((char*)&age, sizeof(age)) || !read_header(in, type_header))
+            return false;
+
+        new_type_index[type] = std::min<size_t>(age, count - 1);
+
+        new_headers[type] = type_header;
+    }
+
+    while (!vertices.empty())
+        remove_oldest(optimizer);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto vertex = new g2o::VertexSE3();
+
+        vertex->setId(allocator->allocate());
+
+        vertex->setEstimate(poses[i]);
+
+        if(FLAG_STATIC)
+            vertex->setFixed(true);
+
+        optimizer.addVertex(vertex);
+
+        vertices.push_back(vertex);
+
+        header.push_back(new_header[i]);
+    }
+
+    // sequence numbers go on from the replaced window, so held numbers don't match the restored vertices
+    index += count;
+
+    for (auto& type : new_type_index)
+        type.second = index - type.second;
+
+    path->poses.clear();
+
+    path_removed = 0;
+
+    type_index = new_type_index;
+
+    headers = new_headers;
+
+    return true;
+}
+
+
+void Robot::clear(g2o::SparseOptimizer& optimizer)
+{
+    while (!vertices.empty())
+        remove_oldest(optimizer);
+}
+
+
+void Robot::reset(g2o::SparseOptimizer& optimizer, const Eigen::Isometry3d& pose, const std_msgs::Header& new_header)
+{
+    clear(optimizer);
+
+    auto vertex = new g2o::VertexSE3();
+
+    vertex->setId(allocator->allocate());
+
+    vertex->setEstimate(pose);
+
+    if(FLAG_STATIC)
+        vertex->setFixed(true);
+
+    optimizer.addVertex(vertex);
+
+    vertices.push_back(vertex);
+
+    header.push_back(new_header);
+
+    ++index;
+
+    path->poses.clear();
+
+    path_removed = 0;
+
+    type_index.clear();
+
+    headers.clear();
+}
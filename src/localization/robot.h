@@ -29,6 +29,8 @@
 #ifndef ROBOT_H
 #define ROBOT_H
 #include <iostream>
+#include <algorithm>
+#include <deque>
 #include <sstream>
 #include <string.h>
 #include <fstream>
@@ -57,66 +59,136 @@
 
 using namespace std;
 
+// Hands out unique g2o vertex ids for all robots of one graph, recycling the ids of removed vertices.
+class VertexIdAllocator
+{
+public:
+
+    VertexIdAllocator():next(0){};
+
+    int allocate()
+    {
+        if (free_ids.empty())
+            return next++;
+
+        int id = free_ids.back();
+        free_ids.pop_back();
+        return id;
+    };
+
+    void release(int id){free_ids.push_back(id);};
+
+private:
+
+    int next;
+
+    std::vector<int> free_ids;
+};
+
+
 class Robot
 {
 public:
 
-    Robot(int ID, bool FLAG_STATIC, int trajectory_length, g2o::SparseOptimizer& optimizer)
-        :ID(ID), FLAG_STATIC(FLAG_STATIC), trajectory_length(trajectory_length)
+    Robot(int ID, bool FLAG_STATIC, int trajectory_length, g2o::SparseOptimizer& optimizer, VertexIdAllocator& allocator)
+        :ID(ID), FLAG_STATIC(FLAG_STATIC), trajectory_length(trajectory_length), window_horizon(0)
     {
         Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
         pose(0,3) = 0; 
         pose(1,3) = 0; 
         pose(2,3) = 0.87;
-        init(optimizer, pose);
+        init(optimizer, allocator, pose);
     }; 
     // only call this constructor without following an init()
 
-    Robot(int ID, bool FLAG_STATIC, int trajectory_length)
-        :ID(ID), FLAG_STATIC(FLAG_STATIC), trajectory_length(trajectory_length){};
-    // call this constructor, then init(optimizer, vertex_init)
+    Robot(int ID, bool FLAG_STATIC, int trajectory_length, double window_horizon = 0)
+        :ID(ID), FLAG_STATIC(FLAG_STATIC), trajectory_length(trajectory_length), window_horizon(window_horizon){};
+    // call this constructor, then init(optimizer, allocator, vertex_init)
+    // trajectory_length caps the window; with window_horizon > 0, vertices older than the horizon (s) are also dropped
 
-    void init(g2o::SparseOptimizer&, Eigen::Isometry3d vertex_init=Eigen::Isometry3d::Identity());
+    void init(g2o::SparseOptimizer&, VertexIdAllocator&, Eigen::Isometry3d vertex_init=Eigen::Isometry3d::Identity());
 
     bool is_static(){return FLAG_STATIC;};
 
     bool not_static(){return ~FLAG_STATIC;};
 
-    g2o::VertexSE3* new_vertex(unsigned char, std_msgs::Header, g2o::SparseOptimizer&);
+    g2o::VertexSE3* new_vertex(unsigned char, const std_msgs::Header&, g2o::SparseOptimizer&);
 
     g2o::VertexSE3* last_vertex(unsigned char);
 
     g2o::VertexSE3* last_vertex();
 
+    g2o::VertexSE3* previous_vertex();
+
+    size_t last_index(unsigned char); // sequence number of last_vertex(type)
+
+    size_t last_index(){return index;};
+
+    g2o::VertexSE3* vertex_at(size_t); // vertex by sequence number, NULL once it left the window
+
+    static const size_t none = (size_t)-1; // sequence number of no vertex
+
+    void tail(size_t, g2o::HyperGraph::VertexSet&);
+
+    void tail(size_t, std::vector<g2o::VertexSE3*>&); // oldest first
+
     std_msgs::Header last_header(unsigned char);
 
     std_msgs::Header last_header();
 
+    std_msgs::Header previous_header();
+
     void append_last_header(string);
 
-    nav_msgs::Path* vertices2path();
+    void update_last_header(unsigned char, const std_msgs::Header&);
+
+    size_t size(){return vertices.size();};
+
+    double span(); // s between the oldest and newest stamped vertex
+
+    double bracket(ros::Time, g2o::VertexSE3*&, g2o::VertexSE3*&); // vertices around a stamp and its interpolation ratio, negative if before the window
+
+    nav_msgs::Path* vertices2path(); // converts only new vertices and those marked changed since the last call
+
+    void mark_changed(size_t newest){path_changed = std::max(path_changed, newest);}; // newest vertices re-estimated
 
     geometry_msgs::PoseStamped current_pose();
 
+    void save(std::ostream&); // binary snapshot of the window: vertex estimates, headers and type indices
+
+    bool restore(std::istream&, g2o::SparseOptimizer&); // replaces the window by a snapshot, call after init
+
+    void clear(g2o::SparseOptimizer&); // removes all vertices, and their edges, from the graph
+
+    void reset(g2o::SparseOptimizer&, const Eigen::Isometry3d&, const std_msgs::Header&); // replaces the window by one vertex
+
 private:
 
+    void remove_oldest(g2o::SparseOptimizer&);
+
     map<unsigned char, std_msgs::Header> headers;
 
-    std::vector<std_msgs::Header> header; // headr corresponding to vertices
+    std::deque<std_msgs::Header> header; // headr corresponding to vertices
+
+    std::deque<g2o::VertexSE3*> vertices; // oldest first
 
-    vector<g2o::VertexSE3*> vertices; //sensor type-> vertices
+    VertexIdAllocator* allocator; // shared by the robots of the graph
 
     nav_msgs::Path* path;
 
-    map<unsigned char, size_t> type_index; //sensor type -> current vertex index
+    size_t path_changed, path_removed; // newest vertices to convert, and oldest poses to drop, at the next vertices2path
 
-    size_t index; // current vertex index
+    map<unsigned char, size_t> type_index; //sensor type -> vertex sequence number
+
+    size_t index; // sequence number of the newest vertex, never reused, also across reset and restore
 
     int ID; // Robot ID
 
     bool FLAG_STATIC;
 
     int trajectory_length;
+
+    double window_horizon;
 };
 
 #endif
@@ -0,0 +1,107 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "trace.h"
+#include <fstream>
+
+
+volatile sig_atomic_t Trace::flag_requested = 0;
+
+
+Trace::Trace(size_t capacity):head(0)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    events.resize(size);
+
+    mask = size - 1;
+}
+
+
+size_t Trace::size() const
+{
+    uint64_t recorded = head.load(std::memory_order_acquire);
+
+    return recorded < events.size() ? recorded : events.size();
+}
+
+
+bool Trace::dump(const std::string& filename) const
+{
+    std::ofstream file(filename.c_str(), std::ios::binary);
+
+    if (!file)
+        return false;
+
+    uint64_t end = head.load(std::memory_order_acquire);
+
+    uint32_t count = size(), version = 1;
+
+    file.write("UWBTRACE", 8);
+    file.write((const char*)&version, sizeof(version));
+    file.write((const char*)&count, sizeof(count));
+
+    for (uint64_t i = end - count; i < end; ++i)
+        file.write((const char*)&events[i & mask], sizeof(Event));
+
+    return file.good();
+}
+
+
+void Trace::install_signal(int signal)
+{
+    struct sigaction action;
+
+    action.sa_handler = &Trace::handler;
+
+    sigemptyset(&action.sa_mask);
+
+    action.sa_flags = SA_RESTART;
+
+    sigaction(signal, &action, NULL);
+}
+
+
+bool Trace::requested()
+{
+    if (!flag_requested)
+        return false;
+
+    flag_requested = 0;
+
+    return true;
+}
+
+
+void Trace::handler(int)
+{
+    flag_requested = 1;
+}
@@ -0,0 +1,92 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+
+// In-memory ring of fixed-size binary events, the newest overwrite the oldest.
+// Recording is one atomic increment and a 24 byte store, no lock and no allocation.
+// The dump layout (little endian) is the 8 byte magic "UWBTRACE", uint32 version, uint32 count,
+// then count events oldest first; script/trace_to_chrome.py converts it to Chrome trace JSON.
+class Trace
+{
+public:
+
+    enum Type : uint32_t {arrival, enqueue, solve_begin, solve_end, publish, reject};
+
+    struct Event
+    {
+        uint64_t time;  // ns, steady clock
+        uint32_t type;
+        uint32_t id;    // sensor type for arrival, edge dimension for enqueue, full window for solve_end, node id for reject
+        double value;   // stamp for arrival, chi2 for enqueue and solves, distance for reject
+    };
+
+    Trace(size_t capacity = 1<<16); // rounded up to a power of two
+
+    void record(Type type, uint32_t id = 0, double value = 0)
+    {
+        uint64_t slot = head.fetch_add(1, std::memory_order_relaxed);
+
+        Event& event = events[slot & mask];
+
+        event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        event.type = type;
+        event.id = id;
+        event.value = value;
+    };
+
+    size_t size() const; // events currently held
+
+    bool dump(const std::string&) const; // events being recorded during a dump may be torn
+
+    static void install_signal(int signal = SIGUSR1); // the signal only raises a flag, see requested()
+
+    static bool requested(); // true once per received signal
+
+private:
+
+    std::vector<Event> events;
+
+    uint64_t mask;
+
+    std::atomic<uint64_t> head;
+
+    static volatile sig_atomic_t flag_requested;
+
+    static void handler(int);
+};
+
+#endif
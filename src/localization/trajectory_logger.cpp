@@ -0,0 +1,173 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "trajectory_logger.h"
+#include <iomanip>
+#include <sstream>
+
+
+bool TrajectoryLogger::open(const std::string& filename, bool binary, const std::string& comment)
+{
+    close();
+
+    this->binary = binary;
+
+    file.open(filename.c_str(), binary ? std::ios::trunc|std::ios::out|std::ios::binary : std::ios::trunc|std::ios::out);
+
+    if (!file)
+        return false;
+
+    if (binary)
+    {
+        uint32_t length = comment.size();
+
+        file.write("UWBTRAJ1", 8);
+        file.write((const char*)&length, sizeof(length));
+        file.write(comment.data(), length);
+    }
+    else
+    {
+        std::istringstream lines(comment);
+
+        std::string line;
+
+        while (std::getline(lines, line))
+            file << "# " << line << "\n";
+    }
+
+    buffer.reserve(capacity);
+
+    writing.reserve(capacity);
+
+    running = true;
+
+    writer = std::thread(&TrajectoryLogger::run, this);
+
+    return true;
+}
+
+
+void TrajectoryLogger::log(const geometry_msgs::PoseStamped& pose)
+{
+    Record record;
+
+    record.stamp = pose.header.stamp.toSec();
+    record.pose[0] = pose.pose.position.x;
+    record.pose[1] = pose.pose.position.y;
+    record.pose[2] = pose.pose.position.z;
+    record.pose[3] = pose.pose.orientation.x;
+    record.pose[4] = pose.pose.orientation.y;
+    record.pose[5] = pose.pose.orientation.z;
+    record.pose[6] = pose.pose.orientation.w;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!running)
+            return;
+
+        if (buffer.size() >= capacity)
+        {
+            ++dropped;
+            return;
+        }
+
+        buffer.push_back(record);
+    }
+
+    condition.notify_one();
+}
+
+
+void TrajectoryLogger::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!running)
+            return;
+
+        running = false;
+    }
+
+    condition.notify_one();
+
+    writer.join();
+
+    file.close();
+}
+
+
+void TrajectoryLogger::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        condition.wait(lock, [this]{return !buffer.empty() || !running;});
+
+        bool stop = !running;
+
+        writing.swap(buffer);
+
+        lock.unlock();
+
+        write(writing);
+
+        writing.clear();
+
+        lock.lock();
+
+        if (stop && buffer.empty())
+            break;
+    }
+}
+
+
+void TrajectoryLogger::write(const std::vector<Record>& records)
+{
+    for (auto& record : records)
+        if (binary)
+        {
+            file.write((const char*)&record.stamp, sizeof(record.stamp));
+            file.write((const char*)record.pose, sizeof(record.pose));
+        }
+        else
+        {
+            file << std::fixed << std::setprecision(9) << record.stamp << std::setprecision(6);
+
+            file.unsetf(std::ios::floatfield);
+
+            for (int i = 0; i < 7; ++i)
+                file << " " << record.pose[i];
+
+            file << "\n";
+        }
+
+    file.flush();
+}
@@ -0,0 +1,94 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRAJECTORY_LOGGER_H
+#define TRAJECTORY_LOGGER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <geometry_msgs/PoseStamped.h>
+
+// Appends poses to a trajectory file from a background thread.
+// log() only copies the pose into a preallocated buffer; the writer swaps buffers and writes in batches.
+// Text files are in TUM format "stamp x y z qx qy qz qw" with "#" comment lines.
+// Binary files start with the 8 byte magic "UWBTRAJ1", a uint32 comment length and the comment,
+// followed by 36 byte records: float64 stamp, float32 x y z qx qy qz qw (little endian).
+// script/trajectory_to_tum.py converts binary files to TUM text for script/evaluate_ate.py.
+class TrajectoryLogger
+{
+public:
+
+    TrajectoryLogger(size_t capacity = 4096):capacity(capacity), running(false), dropped(0){};
+
+    ~TrajectoryLogger(){close();};
+
+    bool open(const std::string& filename, bool binary, const std::string& comment = "");
+
+    void log(const geometry_msgs::PoseStamped&);
+
+    void close(); // writes the remaining poses and joins the writer
+
+    bool is_open(){return running;};
+
+    size_t dropped_poses(){return dropped;}; // poses lost because the writer fell behind
+
+private:
+
+    struct Record
+    {
+        double stamp;
+        float pose[7];
+    };
+
+    void run();
+
+    void write(const std::vector<Record>&);
+
+    size_t capacity;
+
+    bool binary, running;
+
+    size_t dropped;
+
+    std::vector<Record> buffer, writing;
+
+    std::ofstream file;
+
+    std::thread writer;
+
+    std::mutex mutex;
+
+    std::condition_variable condition;
+};
+
+#endif
@@ -30,12 +30,6 @@
 
 #include "localization.h"
 
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
-
-using namespace std;
-using namespace message_filters;
-
 int main(int argc, char** argv)
 {
     ros::init(argc, argv, "ni_slam_node");
@@ -44,58 +38,23 @@ int main(int argc, char** argv)
 
     Localization localization(n);
 
-    string pose_topic, range_topic, lidar_topic, imu_topic, twist_topic, relative_topic;
-
-    ros::Subscriber pose_sub, range_sub, imu_sub, twist_sub, relative_sub;
-
-
-    if(n.getParam("topic/pose", pose_topic))
-    {
-        pose_sub = n.subscribe(pose_topic, 1000, &Localization::addPoseEdge, &localization);
-        ROS_WARN("Subscribing to: %s",pose_topic.c_str());
-    }
+    localization.subscribe(n);
 
-    if(n.getParam("topic/range", range_topic))
-    {
-        range_sub = n.subscribe(range_topic, 1, &Localization::addRangeEdge, &localization);
-        ROS_WARN("Subscribing to: %s", range_topic.c_str());
-    }
+    int threads;
 
-    if(n.getParam("topic/twist", twist_topic))
-    {
-        twist_sub = n.subscribe(twist_topic, 1, &Localization::addTwistEdge, &localization);
-        ROS_WARN("Subscribing to: %s", twist_topic.c_str());
-    }
+    n.param("concurrency/threads", threads, 0);
 
-    if(n.getParam("topic/lidar", lidar_topic))
+    if (threads > 0)
     {
-        twist_sub = n.subscribe(lidar_topic, 1, &Localization::addLidarEdge, &localization);
-        ROS_WARN("Subscribing to: %s", lidar_topic.c_str());
-    }
+        // callbacks, timers and reconfiguration run concurrently, the graph is built and solved on the worker thread
+        ros::AsyncSpinner spinner(threads);
 
-    if(n.getParam("topic/imu", imu_topic))
-    {
-        imu_sub = n.subscribe(imu_topic, 1, &Localization::addImuEdge, &localization);
-        ROS_WARN("Subscribing to: %s", imu_topic.c_str());
-    }
+        spinner.start();
 
-#ifdef RELATIVE_LOCALIZATION
-    if(n.getParam("topic/relative_range", relative_topic))
-    {
-        relative_sub = n.subscribe(relative_topic, 1, &Localization::addRLRangeEdge, &localization);
-        ROS_WARN("Subscribing to: %s", relative_topic.c_str());
+        ros::waitForShutdown();
     }
-#endif
-
-    dynamic_reconfigure::Server<localization::localizationConfig> dr_srv;
-
-    dynamic_reconfigure::Server<localization::localizationConfig>::CallbackType cb;
-
-    cb = boost::bind(&Localization::configCallback, &localization, _1, _2);
-
-    dr_srv.setCallback(cb);
-
-    ros::spin();
+    else
+        ros::spin();
 
     return 0;
 }
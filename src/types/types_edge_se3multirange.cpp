@@ -0,0 +1,117 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "types_edge_se3multirange.h"
+#include "g2o/core/factory.h"
+#include "g2o/stuff/macros.h"
+
+namespace g2o
+{
+    using namespace std;
+
+    using namespace Eigen;
+
+    G2O_REGISTER_TYPE(EDGE_MULTI_RANGE, EdgeSE3MultiRange);
+
+    EdgeSE3MultiRange::EdgeSE3MultiRange():BaseBinaryEdge<4, Eigen::Vector4d, VertexSE3, VertexSE3>(), ranges(0)
+    {
+        _measurement.setZero();
+
+        information().setZero();
+    }
+
+
+    bool EdgeSE3MultiRange::read(std::istream& is)
+    {
+        int size;
+
+        is >> size;
+
+        ranges = 0;
+
+        _measurement.setZero();
+
+        information().setZero();
+
+        for (int i = 0; i < size; ++i)
+        {
+            Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+
+            double distance, distance_information;
+
+            is >> pose(0,3) >> pose(1,3) >> pose(2,3) >> distance >> distance_information;
+
+            if (!addRange(pose, distance, distance_information))
+                return false;
+        }
+
+        return is.good() || is.eof();
+    }
+
+
+    bool EdgeSE3MultiRange::write(std::ostream& os) const
+    {
+        os << ranges;
+
+        for (int i = 0; i < ranges; ++i)
+            os << " " << offset[i](0,3) << " " << offset[i](1,3) << " " << offset[i](2,3)
+               << " " << _measurement[i] << " " << _information(i,i);
+
+        return os.good();
+    }
+
+
+    bool EdgeSE3MultiRange::addRange(const Eigen::Isometry3d& pose, double distance, double information)
+    {
+        if (ranges == Antennas)
+            return false;
+
+        offset[ranges] = pose;
+
+        _measurement[ranges] = distance;
+
+        _information(ranges, ranges) = information;
+
+        ++ranges;
+
+        return true;
+    }
+
+
+    void EdgeSE3MultiRange::computeError()
+    {
+        const VertexSE3* v1 = static_cast<const VertexSE3*>(_vertices[0]);
+
+        const VertexSE3* v2 = static_cast<const VertexSE3*>(_vertices[1]);
+
+        _error.setZero();
+
+        for (int i = 0; i < ranges; ++i)
+            _error[i] = _measurement[i] - ((v1->estimate() * offset[i]).translation() - v2->estimate().translation()).norm();
+    }
+}
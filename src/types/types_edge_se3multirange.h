@@ -0,0 +1,87 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_SE3_MULTI_RANGE
+#define G2O_SE3_MULTI_RANGE
+
+#include <Eigen/Geometry>
+#include <iostream>
+#include "g2o/core/base_vertex.h"
+#include "g2o/core/base_binary_edge.h"
+#include "g2o/stuff/misc.h"
+#include "g2o/stuff/macros.h"
+#include "g2o/types/slam3d/se3quat.h"
+#include "g2o/types/slam3d/types_slam3d.h"
+#include "g2o_types_api.h"
+
+namespace g2o
+{
+    // Ranges from several antennas of the first vertex to the second vertex, measured in one epoch.
+    // Each range has its own antenna offset, so the ranges together also observe the orientation.
+    // The residual has one row per antenna up to Antennas, unused rows have zero error and information.
+    class G2O_TYPES_API EdgeSE3MultiRange : public BaseBinaryEdge<4, Eigen::Vector4d, VertexSE3, VertexSE3>
+    {
+    public:
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        static const int Antennas = 4;
+
+        EdgeSE3MultiRange();
+
+        virtual bool read(std::istream& is);
+
+        virtual bool write(std::ostream& os) const;
+
+        void computeError();
+
+        virtual void setMeasurement(const Eigen::Vector4d& m)
+        {
+            _measurement = m;
+        }
+
+        bool addRange(const Eigen::Isometry3d&, double, double); // antenna offset, distance, information; false if full
+
+        int size() const {return ranges;};
+
+        virtual double initialEstimatePossible(const OptimizableGraph::VertexSet& , OptimizableGraph::Vertex* )
+        {
+            return -1.;
+        }
+
+        virtual void initialEstimate(const OptimizableGraph::VertexSet& , OptimizableGraph::Vertex* ){};
+
+        std::vector<Eigen::Isometry3d> offset = std::vector<Eigen::Isometry3d>(Antennas, Eigen::Isometry3d::Identity());
+
+    private:
+
+        int ranges;
+    };
+}
+
+#endif
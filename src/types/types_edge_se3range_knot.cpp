@@ -0,0 +1,129 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "types_edge_se3range_knot.h"
+#include "g2o/core/factory.h"
+#include "g2o/stuff/macros.h"
+
+namespace g2o
+{
+    using namespace std;
+
+    using namespace Eigen;
+
+    G2O_REGISTER_TYPE(EDGE_RANGE_KNOT, EdgeSE3RangeKnot);
+
+    EdgeSE3RangeKnot::EdgeSE3RangeKnot():BaseMultiEdge<1, double>()
+    {
+        setKnots(1, 0, 1, 0);
+    }
+
+
+    bool EdgeSE3RangeKnot::read(std::istream& is)
+    {
+        int knots_from, knots_to;
+
+        double alpha_from, alpha_to;
+
+        is >> knots_from >> alpha_from >> knots_to >> alpha_to;
+
+        setKnots(knots_from, alpha_from, knots_to, alpha_to);
+
+        double meas;
+
+        is >> meas;
+
+        setMeasurement(meas);
+
+        information().setIdentity();
+
+        is >> information()(0,0);
+
+        return true;
+    }
+
+
+    bool EdgeSE3RangeKnot::write(std::ostream& os) const
+    {
+        os << knots[0] << " " << alpha[0] << " " << knots[1] << " " << alpha[1] << " ";
+
+        os << measurement() << " " << information()(0,0);
+
+        return os.good();
+    }
+
+
+    void EdgeSE3RangeKnot::setKnots(int knots_from, double alpha_from, int knots_to, double alpha_to)
+    {
+        assert(knots_from>=1&&knots_from<=2&&knots_to>=1&&knots_to<=2);
+
+        knots[0] = knots_from;
+
+        knots[1] = knots_to;
+
+        alpha[0] = alpha_from;
+
+        alpha[1] = alpha_to;
+
+        resize(knots_from + knots_to);
+    }
+
+
+    void EdgeSE3RangeKnot::setVertexOffset(int side,  Eigen::Isometry3d& pose)
+    {
+        assert(side>=0&&side<=1);
+        offset[side] = pose;
+    }
+
+
+    Vector3D EdgeSE3RangeKnot::position(int side) const
+    {
+        int first = (side == 0) ? 0 : knots[0];
+
+        const VertexSE3* v0 = static_cast<const VertexSE3*>(_vertices[first]);
+
+        if (knots[side] == 1)
+            return (v0->estimate() * offset[side]).translation();
+
+        const VertexSE3* v1 = static_cast<const VertexSE3*>(_vertices[first+1]);
+
+        // the antenna is rotated with the nearest knot
+        const Eigen::Isometry3d& nearest = (alpha[side] < 0.5) ? v0->estimate() : v1->estimate();
+
+        return (1 - alpha[side]) * v0->estimate().translation() + alpha[side] * v1->estimate().translation()
+                + nearest.linear() * offset[side].translation();
+    }
+
+
+    void EdgeSE3RangeKnot::computeError()
+    {
+        Vector3D dt = position(0) - position(1);
+
+        _error[0] = _measurement - dt.norm();
+    }
+}
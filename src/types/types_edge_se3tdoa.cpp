@@ -0,0 +1,93 @@
+// Copyright (c) <2016>, <Nanyang Technological University> All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+
+// 3. Neither the name of the copyright holder nor the names of its contributors
+// may be used to endorse or promote products derived from this software without
+// specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "types_edge_se3tdoa.h"
+#include "g2o/core/factory.h"
+#include "g2o/stuff/macros.h"
+
+namespace g2o
+{
+    using namespace std;
+
+    using namespace Eigen;
+
+    G2O_REGISTER_TYPE(EDGE_TDOA, EdgeSE3TDoA);
+
+    EdgeSE3TDoA::EdgeSE3TDoA():BaseMultiEdge<1, double>()
+    {
+        resize(3);
+    }
+
+
+    bool EdgeSE3TDoA::read(std::istream& is)
+    {
+        is >> offset(0,3) >> offset(1,3) >> offset(2,3);
+
+        double meas;
+
+        is >> meas;
+
+        setMeasurement(meas);
+
+        information().setIdentity();
+
+        is >> information()(0,0);
+
+        return true;
+    }
+
+
+    bool EdgeSE3TDoA::write(std::ostream& os) const
+    {
+        os << offset(0,3) << " " << offset(1,3) << " " << offset(2,3) << " ";
+
+        os << measurement() << " " << information()(0,0);
+
+        return os.good();
+    }
+
+
+    void EdgeSE3TDoA::setVertexOffset(Eigen::Isometry3d& pose)
+    {
+        offset = pose;
+    }
+
+
+    void EdgeSE3TDoA::computeError()
+    {
+        const VertexSE3* tag = static_cast<const VertexSE3*>(_vertices[0]);
+
+        const VertexSE3* anchor = static_cast<const VertexSE3*>(_vertices[1]);
+
+        const VertexSE3* reference = static_cast<const VertexSE3*>(_vertices[2]);
+
+        Vector3D position = (tag->estimate() * offset).translation();
+
+        _error[0] = _measurement - ((position - anchor->estimate().translation()).norm() - (position - reference->estimate().translation()).norm());
+    }
+}